@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+template <class Mixer>
+using Shadow = HopscotchShadow<uint64_t, std::hash<uint64_t>,
+                               PowerOfTwoGrowthPolicy, false, uint32_t,
+                               SparseStorage, Mixer>;
+
+// auto-increment IDs
+vector<uint64_t> sequential_keys(int num_keys) {
+    vector<uint64_t> res(num_keys);
+    for (int i = 0; i < num_keys; ++i) {
+        res[i] = static_cast<uint64_t>(i) + 1;
+    }
+    return res;
+}
+
+// IDs 2^shift apart, the low shift bits are always 0
+vector<uint64_t> stride_keys(int num_keys, int shift) {
+    vector<uint64_t> res(num_keys);
+    for (int i = 0; i < num_keys; ++i) {
+        res[i] = (static_cast<uint64_t>(i) + 1) << shift;
+    }
+    return res;
+}
+
+// runs of 64 consecutive IDs, each run starting at a random multiple of 2^20
+vector<uint64_t> clustered_keys(int num_keys, std::mt19937& rng) {
+    std::uniform_int_distribution<uint64_t> pick_run(1, uint64_t{1} << 30);
+    vector<uint64_t> res{};
+    res.reserve(num_keys);
+    while (static_cast<int>(res.size()) < num_keys) {
+        uint64_t start = pick_run(rng) << 20;
+        for (int i = 0; i < 64 && static_cast<int>(res.size()) < num_keys;
+             ++i) {
+            res.push_back(start + i);
+        }
+    }
+    return res;
+}
+
+// load factor at the end shows growth past what max_load needed, counter is
+// the number of keys in when the table gave up (all of them if it didn't)
+template <class Table>
+TableTiming time_inserts(const string& name, const vector<uint64_t>& keys) {
+    Table table{};
+    table.set_deleted_key(0);
+    int num_inserted = 0;
+    auto begin = std::chrono::steady_clock::now();
+    try {
+        for (uint64_t key : keys) {
+            table.insert(key);
+            ++num_inserted;
+        }
+    } catch (const std::runtime_error&) {
+        // resizes failed, neighborhoods can't take this pattern
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, table.load_factor(), num_inserted};
+}
+
+void bench_pattern(const string& pattern, const vector<uint64_t>& keys,
+                   int repetition) {
+    report_results(
+        "insert_" + pattern,
+        " " + pattern + " keys inserted (counter = keys in before a failure):",
+        static_cast<int64_t>(keys.size()), 1, repetition,
+        {time_inserts<Shadow<NoMixing>>("Hopscotch shadow", keys),
+         time_inserts<Shadow<FibonacciMixing>>("Hopscotch shadow fibonacci",
+                                               keys),
+         time_inserts<Shadow<Murmur3Mixing>>("Hopscotch shadow murmur3",
+                                             keys)});
+}
+
+}  // namespace
+
+void bench_adversarial_keys() {
+    const int num_keys = 1'000'000;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        std::mt19937 rng = make_bench_rng(num_keys, 1300, repetition);
+        bench_pattern("sequential", sequential_keys(num_keys), repetition);
+        for (int shift : {4, 10, 16}) {
+            bench_pattern("stride_2^" + std::to_string(shift),
+                          stride_keys(num_keys, shift), repetition);
+        }
+        bench_pattern("clustered", clustered_keys(num_keys, rng), repetition);
+    }
+}
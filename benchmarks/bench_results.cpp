@@ -0,0 +1,300 @@
+#include "bench_results.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+
+vector<BenchResult> collected_results{};
+
+string to_table_id(const string& display_name) {
+    // "Hopscotch shadow" -> "hopscotch_shadow"
+    string res = display_name;
+    for (char& c : res) {
+        c = (c == ' ') ? '_' : static_cast<char>(std::tolower(c));
+    }
+    return res;
+}
+
+void write_csv(std::ostream& os) {
+    os << "table,op,size,tries,repetition,time_ms,load_factor\n";
+    for (const auto& r : collected_results) {
+        os << r.table << "," << r.op << "," << r.size << "," << r.tries << ","
+           << r.repetition << "," << r.time_ms << "," << r.load_factor
+           << "\n";
+    }
+}
+
+void write_json(std::ostream& os) {
+    os << "[\n";
+    for (size_t i = 0; i < collected_results.size(); ++i) {
+        const auto& r = collected_results[i];
+        os << "  {\"table\": \"" << r.table << "\", \"op\": \"" << r.op
+           << "\", \"size\": " << r.size << ", \"tries\": " << r.tries
+           << ", \"repetition\": " << r.repetition
+           << ", \"time_ms\": " << r.time_ms
+           << ", \"load_factor\": " << r.load_factor << "}"
+           << (i + 1 == collected_results.size() ? "\n" : ",\n");
+    }
+    os << "]\n";
+}
+
+void set_field(BenchResult& r, const string& key, const string& value) {
+    if (key == "table") {
+        r.table = value;
+    } else if (key == "op") {
+        r.op = value;
+    } else if (key == "size") {
+        r.size = std::stoll(value);
+    } else if (key == "tries") {
+        r.tries = std::stoi(value);
+    } else if (key == "repetition") {
+        r.repetition = std::stoi(value);
+    } else if (key == "time_ms") {
+        r.time_ms = std::stod(value);
+    } else if (key == "load_factor") {
+        r.load_factor = std::stod(value);
+    }
+    // unknown fields are ignored so that files of newer benches can be compared
+}
+
+vector<BenchResult> parse_csv(std::istream& is) {
+    vector<BenchResult> res;
+    string line;
+    vector<string> header;
+    while (std::getline(is, line)) {
+        if (line.empty()) continue;
+        vector<string> cells;
+        std::stringstream ss(line);
+        string cell;
+        while (std::getline(ss, cell, ',')) {
+            cells.push_back(cell);
+        }
+        if (header.empty()) {
+            header = cells;
+            continue;
+        }
+        BenchResult r;
+        for (size_t i = 0; i < cells.size() && i < header.size(); ++i) {
+            set_field(r, header[i], cells[i]);
+        }
+        res.push_back(r);
+    }
+    return res;
+}
+
+// parses only what write_json produces: an array of flat objects
+vector<BenchResult> parse_json(const string& text) {
+    vector<BenchResult> res;
+    size_t pos = 0;
+    while ((pos = text.find('{', pos)) != string::npos) {
+        size_t end = text.find('}', pos);
+        if (end == string::npos) {
+            throw std::runtime_error("Malformed json: unclosed object");
+        }
+        BenchResult r;
+        size_t cur = pos + 1;
+        while (true) {
+            size_t key_begin = text.find('"', cur);
+            if (key_begin == string::npos || key_begin > end) break;
+            size_t key_end = text.find('"', key_begin + 1);
+            string key = text.substr(key_begin + 1, key_end - key_begin - 1);
+            size_t colon = text.find(':', key_end);
+            size_t value_begin = colon + 1;
+            while (std::isspace(static_cast<unsigned char>(text[value_begin]))) {
+                ++value_begin;
+            }
+            string value;
+            if (text[value_begin] == '"') {
+                size_t value_end = text.find('"', value_begin + 1);
+                value = text.substr(value_begin + 1, value_end - value_begin - 1);
+                cur = value_end + 1;
+            } else {
+                size_t value_end = text.find_first_of(",}", value_begin);
+                value = text.substr(value_begin, value_end - value_begin);
+                cur = value_end;
+            }
+            set_field(r, key, value);
+        }
+        res.push_back(r);
+        pos = end + 1;
+    }
+    return res;
+}
+
+// two-sided 95% critical values of Student's t distribution for df = 1..30
+double t_critical_95(double df) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < 1.0) return table[0];
+    if (df > 30.0) return 1.960;
+    return table[static_cast<int>(std::floor(df)) - 1];
+}
+
+struct Sample {
+    int n = 0;
+    double mean = 0.0;
+    double variance = 0.0;  // sample variance, 0 for n < 2
+};
+
+Sample summarize(const vector<double>& times) {
+    Sample s;
+    s.n = static_cast<int>(times.size());
+    if (s.n == 0) return s;
+    for (double t : times) s.mean += t;
+    s.mean /= s.n;
+    if (s.n < 2) return s;
+    for (double t : times) s.variance += (t - s.mean) * (t - s.mean);
+    s.variance /= (s.n - 1);
+    return s;
+}
+
+double half_interval(const Sample& s) {
+    if (s.n < 2) return 0.0;
+    return t_critical_95(s.n - 1) * std::sqrt(s.variance / s.n);
+}
+
+using PointKey = std::tuple<string, string, int64_t>;  // table, op, size
+
+std::map<PointKey, vector<double>> group_times(
+    const vector<BenchResult>& results) {
+    std::map<PointKey, vector<double>> res;
+    for (const auto& r : results) {
+        res[{r.table, r.op, r.size}].push_back(r.time_ms);
+    }
+    return res;
+}
+
+}  // namespace
+
+BenchConfig& bench_config() {
+    static BenchConfig config{};
+    return config;
+}
+
+std::mt19937 make_bench_rng(int size, int op, int repetition) {
+    uint64_t seed = bench_config().seed;
+    std::seed_seq seq{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+                      static_cast<uint32_t>(size), static_cast<uint32_t>(op),
+                      static_cast<uint32_t>(repetition)};
+    return std::mt19937(seq);
+}
+
+void report_results(const string& op, const string& header, int64_t size,
+                    int num_tries, int repetition,
+                    const vector<TableTiming>& timings) {
+    if (bench_config().format == OutputFormat::Text) {
+        cout << size << header << endl;
+        for (const auto& t : timings) {
+            cout << t.display_name << ": " << t.time;
+            if (t.counter >= 0) {
+                cout << " on load_factor " << t.load_factor
+                     << ", counter = " << t.counter;
+            }
+            cout << endl;
+        }
+        cout << "---------------" << endl;
+        return;
+    }
+    for (const auto& t : timings) {
+        collected_results.push_back({to_table_id(t.display_name), op, size,
+                                     num_tries, repetition, t.time.count(),
+                                     t.load_factor});
+    }
+}
+
+void write_results() {
+    const BenchConfig& config = bench_config();
+    if (config.format == OutputFormat::Text) return;
+    std::ofstream file;
+    if (!config.output_path.empty()) {
+        file.open(config.output_path);
+        if (!file) {
+            throw std::runtime_error("Can't open " + config.output_path);
+        }
+    }
+    std::ostream& os = config.output_path.empty() ? cout : file;
+    os << std::setprecision(10);
+    if (config.format == OutputFormat::Csv) {
+        write_csv(os);
+    } else {
+        write_json(os);
+    }
+}
+
+vector<BenchResult> read_results(const string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    string text = buffer.str();
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first != string::npos && (text[first] == '[' || text[first] == '{')) {
+        return parse_json(text);
+    }
+    std::stringstream ss(text);
+    return parse_csv(ss);
+}
+
+int compare_results(const string& baseline_path, const string& candidate_path,
+                    double min_slowdown) {
+    auto baseline = group_times(read_results(baseline_path));
+    auto candidate = group_times(read_results(candidate_path));
+
+    int regressions = 0;
+    cout << std::fixed << std::setprecision(3);
+    for (const auto& [point, base_times] : baseline) {
+        auto it = candidate.find(point);
+        if (it == candidate.end()) continue;
+        const auto& [table, op, size] = point;
+        Sample base = summarize(base_times);
+        Sample cand = summarize(it->second);
+        double diff = cand.mean - base.mean;
+        double relative = base.mean > 0.0 ? diff / base.mean : 0.0;
+
+        string verdict = "ok";
+        if (base.n < 2 || cand.n < 2) {
+            verdict = "n/a (need >= 2 repetitions)";
+        } else {
+            // Welch's t-test on the difference of means
+            double base_se2 = base.variance / base.n;
+            double cand_se2 = cand.variance / cand.n;
+            double se = std::sqrt(base_se2 + cand_se2);
+            double df = (se > 0.0)
+                            ? std::pow(base_se2 + cand_se2, 2) /
+                                  (base_se2 * base_se2 / (base.n - 1) +
+                                   cand_se2 * cand_se2 / (cand.n - 1))
+                            : base.n + cand.n - 2;
+            double margin = t_critical_95(df) * se;
+            if (diff - margin > 0.0 && relative > min_slowdown) {
+                verdict = "REGRESSION";
+                ++regressions;
+            } else if (diff + margin < 0.0) {
+                verdict = "improvement";
+            }
+        }
+        cout << table << " " << op << " " << size << ": " << base.mean
+             << " +- " << half_interval(base) << " ms -> " << cand.mean
+             << " +- " << half_interval(cand) << " ms (" << relative * 100.0
+             << "%) " << verdict << endl;
+    }
+    cout << regressions << " significant regression(s)" << endl;
+    return regressions;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+enum class OutputFormat { Text, Json, Csv };
+
+// global settings of a bench run, filled from the command line in main.cpp
+struct BenchConfig {
+    uint64_t seed = 0x5EED;  // every rng in benches is derived from this
+    OutputFormat format = OutputFormat::Text;
+    int repetitions = 1;
+    std::string output_path{};  // empty -> stdout
+    std::string data_dir{};     // where benches put files, empty -> temp dir
+    std::string dataset_cache{};  // key sets are kept here, empty -> none
+};
+
+BenchConfig& bench_config();
+
+// one measured (table, op, size) point of one repetition
+struct BenchResult {
+    std::string table;
+    std::string op;
+    int64_t size = 0;
+    int tries = 0;
+    int repetition = 0;
+    double time_ms = 0.0;
+    double load_factor = 0.0;
+};
+
+// what a bench reports for a single table, display_name is used in text output
+struct TableTiming {
+    std::string display_name;
+    std::chrono::duration<double, std::milli> time;
+    double load_factor;
+    int counter = -1;  // < 0 means "don't print"
+};
+
+// deterministic rng for given bench point, doesn't depend on the order of bench calls
+std::mt19937 make_bench_rng(int size, int op, int repetition);
+
+// prints in text mode right away, otherwise collects results until write_results
+void report_results(const std::string& op, const std::string& header,
+                    int64_t size, int num_tries, int repetition,
+                    const std::vector<TableTiming>& timings);
+
+// writes everything collected by report_results in configured format
+void write_results();
+
+std::vector<BenchResult> read_results(const std::string& path);
+
+// compares two result files (csv or json), prints per-point statistics
+// returns number of statistically significant regressions of candidate against baseline
+int compare_results(const std::string& baseline_path,
+                    const std::string& candidate_path,
+                    double min_slowdown = 0.0);
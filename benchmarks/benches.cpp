@@ -4,14 +4,17 @@
 #include <chrono>
 #include <iostream>
 #include <random>
+#include <span>
 #include <sparsehash/dense_hash_set>
 #include <sparsehash/sparse_hash_set>
 #include <stdexcept>
 #include <unordered_set>
 #include <vector>
 
-#include "hopscotch_shadow.h"
+#include "bench_results.h"
 #include "hopscotch_bitmaps.h"
+#include "hopscotch_shadow.h"
+#include "key_sets.h"
 
 using namespace std::chrono_literals;
 
@@ -42,30 +45,27 @@ double test_insert(const vector<int>& to_insert, int num_tries) {
 // cout << test_insert<std::unordered_set<int>>(to_insert, num_tries);
 // cout << test_insert<std::unordered_set<int>>(to_insert, num_tries);*/
 
-void bench_single_size_and_op(int size, OpType type, int num_tries) {
-    std::random_device rd;
-    std::mt19937 rng(rd());
-    std::uniform_int_distribution<std::mt19937::result_type> distrib(0, 1'000'000'000);
-    unordered_set<int> elems{};
-    while (static_cast<int>(elems.size()) < size) {
-        elems.insert(distrib(rng));
-    }
-    vector<int> to_insert{};
-    for (int v : elems) {
-        to_insert.push_back(v);
-    }
-    std::ranges::shuffle(to_insert, rng);
+void bench_single_size_and_op(int size, OpType type, int num_tries,
+                              int repetition) {
+    std::mt19937 rng =
+        make_bench_rng(size, static_cast<int>(type), repetition);
+    // misses only for false contains, the other ops don't need them
+    KeySet keys(size, type == OpType::FalseContains ? size : 0, rng);
+    std::span<int> to_insert = keys.hits();
 
     if (type == OpType::Insert) {
+        double uset_load_factor = 0.0;
         auto uset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries; ++i) {
             unordered_set<int> uset_to_bench{};
             for (int v : to_insert) {
                 uset_to_bench.insert(v);
             }
+            uset_load_factor = uset_to_bench.load_factor();
         }
         auto uset_end = std::chrono::steady_clock::now();
 
+        double sset_load_factor = 0.0;
         auto sset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries; ++i) {
             sparse_hash_set<int> sset_to_bench{};
@@ -73,9 +73,11 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
             for (int v : to_insert) {
                 sset_to_bench.insert(v);
             }
+            sset_load_factor = sset_to_bench.load_factor();
         }
         auto sset_end = std::chrono::steady_clock::now();
 
+        double dset_load_factor = 0.0;
         auto dset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries; ++i) {
             dense_hash_set<int> dset_to_bench{};
@@ -84,24 +86,29 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
             for (int v : to_insert) {
                 dset_to_bench.insert(v);
             }
+            dset_load_factor = dset_to_bench.load_factor();
         }
         auto dset_end = std::chrono::steady_clock::now();
 
+        double hset_load_factor = 0.0;
         auto hset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries; ++i) {
             HopscotchShadow<int> hset_to_bench{};
             for (int v : to_insert) {
                 hset_to_bench.insert(v);
             }
+            hset_load_factor = hset_to_bench.load_factor();
         }
         auto hset_end = std::chrono::steady_clock::now();
 
+        double hbset_load_factor = 0.0;
         auto hbset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries; ++i) {
             HopscotchHashSet<int> hbset_to_bench{};
             for (int v : to_insert) {
                 hbset_to_bench.add(v);
             }
+            hbset_load_factor = hbset_to_bench.load_factor();
         }
         auto hbset_end = std::chrono::steady_clock::now();
 
@@ -116,13 +123,12 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
         std::chrono::duration<double, std::milli> hbset_time =
             hbset_end - hbset_begin;
 
-        cout << size << " inserts:" << endl;
-        cout << "Unordered_set: " << uset_time << endl;
-        cout << "Sparse_hash_set: " << sset_time << endl;
-        cout << "Dense_hash_set: " << dset_time << endl;
-        cout << "Hopscotch shadow: " << hset_time << endl;
-        cout << "Hopscotch bitmaps: " << hbset_time << endl;
-        cout << "---------------" << endl;
+        report_results("insert", " inserts:", size, num_tries, repetition,
+                       {{"Unordered_set", uset_time, uset_load_factor},
+                        {"Sparse_hash_set", sset_time, sset_load_factor},
+                        {"Dense_hash_set", dset_time, dset_load_factor},
+                        {"Hopscotch shadow", hset_time, hset_load_factor},
+                        {"Hopscotch bitmaps", hbset_time, hbset_load_factor}});
     } else if (type == OpType::Remove) {
         vector<unordered_set<int>> usets(num_tries);
         vector<sparse_hash_set<int>> ssets(num_tries);
@@ -158,6 +164,13 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
             }
         }
         std::ranges::shuffle(to_insert, rng);
+        // load factors of full tables, after removes they are just 0
+        double uset_load_factor = usets.empty() ? 0.0 : usets[0].load_factor();
+        double sset_load_factor = ssets.empty() ? 0.0 : ssets[0].load_factor();
+        double dset_load_factor = dsets.empty() ? 0.0 : dsets[0].load_factor();
+        double hset_load_factor = hsets.empty() ? 0.0 : hsets[0].load_factor();
+        double hbset_load_factor =
+            hbsets.empty() ? 0.0 : hbsets[0].load_factor();
 
         auto uset_begin = std::chrono::steady_clock::now();
         for (auto& uset_to_bench : usets) {
@@ -210,13 +223,12 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
         std::chrono::duration<double, std::milli> hbset_time =
             hbset_end - hbset_begin;
 
-        cout << size << " removes:" << endl;
-        cout << "Unordered_set: " << uset_time << endl;
-        cout << "Sparse_hash_set: " << sset_time << endl;
-        cout << "Dense_hash_set: " << dset_time << endl;
-        cout << "Hopscotch shadow: " << hset_time << endl;
-        cout << "Hopscotch bitmaps: " << hbset_time << endl;
-        cout << "---------------" << endl;
+        report_results("remove", " removes:", size, num_tries, repetition,
+                       {{"Unordered_set", uset_time, uset_load_factor},
+                        {"Sparse_hash_set", sset_time, sset_load_factor},
+                        {"Dense_hash_set", dset_time, dset_load_factor},
+                        {"Hopscotch shadow", hset_time, hset_load_factor},
+                        {"Hopscotch bitmaps", hbset_time, hbset_load_factor}});
     } else if (type == OpType::TrueContains) {
         unordered_set<int> uset_to_bench{};
         for (int v : to_insert) {
@@ -253,28 +265,28 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
         int scounter = 0;
         auto sset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            scounter += (sset_to_bench.find(to_insert[i % num_tries]) != sset_to_bench.end());
+            scounter += (sset_to_bench.find(to_insert[i % size]) != sset_to_bench.end());
         }
         auto sset_end = std::chrono::steady_clock::now();
 
         int dcounter = 0;
         auto dset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            dcounter += (dset_to_bench.find(to_insert[i % num_tries]) != dset_to_bench.end());
+            dcounter += (dset_to_bench.find(to_insert[i % size]) != dset_to_bench.end());
         }
         auto dset_end = std::chrono::steady_clock::now();
 
         int hcounter = 0;
         auto hset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            hcounter += hset_to_bench.contains(to_insert[i % num_tries]);
+            hcounter += hset_to_bench.contains(to_insert[i % size]);
         }
         auto hset_end = std::chrono::steady_clock::now();
 
         int hbcounter = 0;
         auto hbset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            hbcounter += hbset_to_bench.contains(to_insert[i % num_tries]);
+            hbcounter += hbset_to_bench.contains(to_insert[i % size]);
         }
         auto hbset_end = std::chrono::steady_clock::now();
 
@@ -289,27 +301,16 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
         std::chrono::duration<double, std::milli> hbset_time =
             hbset_end - hbset_begin;
 
-        cout << size << " true contains: " << endl;
-        cout << "Unordered_set: " << uset_time << " on load_factor " << uset_to_bench.load_factor() << ", counter = " << ucounter << endl;
-        cout << "Sparse_hash_set: " << sset_time << " on load_factor " << sset_to_bench.load_factor() << ", counter = " << scounter  << endl;
-        cout << "Dense_hash_set: " << dset_time << " on load_factor " << dset_to_bench.load_factor() << ", counter = " << dcounter  << endl;
-        cout << "Hopscotch shadow: " << hset_time << " on load_factor " << hset_to_bench.load_factor() << ", counter = " << hcounter  << endl;
-        cout << "Hopscotch bitmaps: " << hbset_time << " on load_factor " << hbset_to_bench.load_factor() << ", counter = " << hbcounter  << endl;
-        cout << "---------------" << endl;
+        report_results(
+            "true_contains", " true contains: ", size, num_tries, repetition,
+            {{"Unordered_set", uset_time, uset_to_bench.load_factor(), ucounter},
+             {"Sparse_hash_set", sset_time, sset_to_bench.load_factor(), scounter},
+             {"Dense_hash_set", dset_time, dset_to_bench.load_factor(), dcounter},
+             {"Hopscotch shadow", hset_time, hset_to_bench.load_factor(), hcounter},
+             {"Hopscotch bitmaps", hbset_time, hbset_to_bench.load_factor(),
+              hbcounter}});
     } else if (type == OpType::FalseContains) {
-        // generate false guesses
-        unordered_set<int> false_elems{};
-        while (static_cast<int>(false_elems.size()) < size) {
-            int guess = distrib(rng);
-            if (!elems.contains(guess)) {
-                false_elems.insert(guess);
-            }
-        }
-        vector<int> false_guesses{};
-        for (int v : false_elems) {
-            false_guesses.push_back(v);
-        }
-        std::ranges::shuffle(false_guesses, rng);
+        std::span<int> false_guesses = keys.misses();
 
         unordered_set<int> uset_to_bench{};
         for (int v : to_insert) {
@@ -345,28 +346,28 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
         int scounter = 0;
         auto sset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            scounter += (sset_to_bench.find(false_guesses[i % num_tries]) != sset_to_bench.end());
+            scounter += (sset_to_bench.find(false_guesses[i % size]) != sset_to_bench.end());
         }
         auto sset_end = std::chrono::steady_clock::now();
 
         int dcounter = 0;
         auto dset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            dcounter += (dset_to_bench.find(false_guesses[i % num_tries]) != dset_to_bench.end());
+            dcounter += (dset_to_bench.find(false_guesses[i % size]) != dset_to_bench.end());
         }
         auto dset_end = std::chrono::steady_clock::now();
 
         int hcounter = 0;
         auto hset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            hcounter += hset_to_bench.contains(false_guesses[i % num_tries]);
+            hcounter += hset_to_bench.contains(false_guesses[i % size]);
         }
         auto hset_end = std::chrono::steady_clock::now();
 
         int hbcounter = 0;
         auto hbset_begin = std::chrono::steady_clock::now();
         for (int i = 0; i < num_tries * size; ++i) {
-            hbcounter += hbset_to_bench.contains(false_guesses[i % num_tries]);
+            hbcounter += hbset_to_bench.contains(false_guesses[i % size]);
         }
         auto hbset_end = std::chrono::steady_clock::now();
 
@@ -381,31 +382,37 @@ void bench_single_size_and_op(int size, OpType type, int num_tries) {
         std::chrono::duration<double, std::milli> hbset_time =
             hbset_end - hbset_begin;
 
-        cout << size << " false contains: " << endl;
-        cout << "Unordered_set: " << uset_time << " on load_factor " << uset_to_bench.load_factor() << ", counter = " << ucounter << endl;
-        cout << "Sparse_hash_set: " << sset_time << " on load_factor " << sset_to_bench.load_factor() << ", counter = " << scounter  << endl;
-        cout << "Dense_hash_set: " << dset_time << " on load_factor " << dset_to_bench.load_factor() << ", counter = " << dcounter  << endl;
-        cout << "Hopscotch shadow: " << hset_time << " on load_factor " << hset_to_bench.load_factor() << ", counter = " << hcounter  << endl;
-        cout << "Hopscotch bitmaps: " << hbset_time << " on load_factor " << hbset_to_bench.load_factor() << ", counter = " << hbcounter  << endl;
-        cout << "---------------" << endl;
+        report_results(
+            "false_contains", " false contains: ", size, num_tries, repetition,
+            {{"Unordered_set", uset_time, uset_to_bench.load_factor(), ucounter},
+             {"Sparse_hash_set", sset_time, sset_to_bench.load_factor(), scounter},
+             {"Dense_hash_set", dset_time, dset_to_bench.load_factor(), dcounter},
+             {"Hopscotch shadow", hset_time, hset_to_bench.load_factor(), hcounter},
+             {"Hopscotch bitmaps", hbset_time, hbset_to_bench.load_factor(),
+              hbcounter}});
     } else {
         throw std::runtime_error("Unsupported OpType");
     }
 }
 
-void bench_single_size(int size, int num_tries) {
+void bench_single_size(int size, int num_tries, int repetition) {
     vector<OpType> ops_to_test{OpType::Insert, OpType::Remove, OpType::TrueContains, OpType::FalseContains};
     for (int i = 0; i < static_cast<int>(ops_to_test.size()); ++i) {
-        bench_single_size_and_op(size, ops_to_test[i], num_tries);
+        bench_single_size_and_op(size, ops_to_test[i], num_tries, repetition);
     }
 }
 
 void bench_everything() {
     vector<pair<int, int>> benches{{1'000, 1'000}, {10'000, 100}, {100'000, 20}, {1'000'000, 5}, {10'000'000, 1}};
-    for (auto size_and_num_tries : benches) {
-        int size = size_and_num_tries.first;
-        int num_tries = size_and_num_tries.second;
-        bench_single_size(size, num_tries);
-        cout << "____________________" << endl;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (auto size_and_num_tries : benches) {
+            int size = size_and_num_tries.first;
+            int num_tries = size_and_num_tries.second;
+            bench_single_size(size, num_tries, repetition);
+            if (bench_config().format == OutputFormat::Text) {
+                cout << "____________________" << endl;
+            }
+        }
     }
 }
@@ -2,8 +2,67 @@
 
 enum class OpType { Insert, Remove, TrueContains, FalseContains };
 
-void bench_single_size_and_op(int size, OpType type, int num_tries);
+// repetition only selects the dataset, see make_bench_rng
+void bench_single_size_and_op(int size, OpType type, int num_tries,
+                              int repetition = 0);
 
-void bench_single_size(int size, int num_tries);
+void bench_single_size(int size, int num_tries, int repetition = 0);
 
 void bench_everything();
+
+// contains/insert on working sets sized for L1, L2, LLC and DRAM, see cache_sweep.cpp
+void bench_cache_sweep();
+
+// string and composite-struct keys over all tables with the same hasher, see key_families.cpp
+void bench_key_families();
+
+// achievable load factor and lookups of HopscotchHashSet for 8/16/32/64-slot neighborhoods
+void bench_hop_ranges();
+
+// HopscotchHashSet insert cost per 10% band of load factor, up to the first failed add
+void bench_high_load_inserts();
+
+// bulk inserts with and without reserve(), for every growth policy, see reserve.cpp
+void bench_reserve();
+
+// HopscotchShadow lookups with and without the hop_range bound, at rising load factors
+void bench_bounded_lookup();
+
+// long erase/insert churn, tombstones against backward-shift erase, see churn.cpp
+void bench_churn();
+
+// plain contains against coroutine-interleaved lookups on 10M and 100M keys, see lookup_pipeline.cpp
+void bench_lookup_pipeline();
+
+// HopscotchCountingSet against unordered_map<K, uint32_t> and unordered_multiset on zipfian streams
+void bench_counting();
+
+// bulk intersect/difference against a contains loop, for aligned and differently laid out tables
+void bench_set_algebra();
+
+// 32-bit against 64-bit size_type on 10M keys, then 64-bit tables past 2^32 slots if memory allows
+void bench_large_table();
+
+// HopscotchShadow rebuild into a doubled table on 1, 2, 4, ... threads, see parallel_resize.cpp
+void bench_parallel_resize();
+
+// file-backed HopscotchHashSet against the in-memory one, below and above RAM, see mapped.cpp
+void bench_mapped();
+
+// reader lookups while one writer grows a HopscotchShadow, shared_mutex against SnapshotShadow
+void bench_snapshot_readers();
+
+// many producer threads filling one table, a mutex per insert against InsertBuffers batches
+void bench_insert_buffers();
+
+// dedup_files over a file of 8-byte keys against sort -u on the same keys as text, see dedup.cpp
+void bench_dedup();
+
+// HopscotchShadow inserts of sequential, strided and clustered IDs with and without a Mixer
+void bench_adversarial_keys();
+
+// HopscotchShadow on sparsetable, SparseGroupTable and DenseTable: inserts, lookups and heap in use
+void bench_sparse_groups();
+
+// erase_if against collecting the keys and erasing them one by one, on one and on all hardware threads
+void bench_erase_if();
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const uint32_t kTableSize = 1 << 20;
+const int kNumTries = 5;
+
+// 2 * num_keys distinct keys in random order
+vector<int> make_distinct_keys(int num_keys, std::mt19937& rng) {
+    std::uniform_int_distribution<int> distrib(0, 2'000'000'000);
+    vector<int> res{};
+    while (static_cast<int>(res.size()) < 2 * num_keys) {
+        while (static_cast<int>(res.size()) < 2 * num_keys + 1000) {
+            res.push_back(distrib(rng));
+        }
+        std::ranges::sort(res);
+        res.erase(std::unique(res.begin(), res.end()), res.end());
+    }
+    std::ranges::shuffle(res, rng);
+    res.resize(2 * num_keys);
+    return res;
+}
+
+TableTiming time_contains(const string& name,
+                          HopscotchShadow<int>& table,
+                          const vector<int>& lookups, LookupMode mode) {
+    table.set_lookup_mode(mode);
+    int counter = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < kNumTries; ++i) {
+        for (int v : lookups) {
+            counter += contains_key(table, v);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, table.load_factor(), counter};
+}
+
+}  // namespace
+
+void bench_bounded_lookup() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int percent : {50, 70, 80, 85, 90}) {
+            int num_keys = static_cast<int>(
+                std::llround(static_cast<double>(kTableSize) * percent / 100));
+            std::mt19937 rng = make_bench_rng(num_keys, 400, repetition);
+            vector<int> all_keys = make_distinct_keys(num_keys, rng);
+            vector<int> keys(all_keys.begin(), all_keys.begin() + num_keys);
+            vector<int> misses(all_keys.begin() + num_keys, all_keys.end());
+
+            // default neighborhoods overflow and grow the table before 0.8,
+            // misses are only long past that
+            HopscotchShadow<int> table(64, 1024, 2);
+            prepare_table(table);
+            table.set_size(kTableSize);
+            for (int v : keys) {
+                insert_key(table, v);
+            }
+            // report where the table really is, in case it grew anyway
+            string load = std::to_string(table.load_factor());
+            string suffix = "_load_" + std::to_string(percent);
+            report_results(
+                "false_contains" + suffix,
+                " false contains at load " + load + ":", num_keys, kNumTries,
+                repetition,
+                {time_contains("Hopscotch shadow probe", table, misses,
+                               LookupMode::Probe),
+                 time_contains("Hopscotch shadow bounded", table, misses,
+                               LookupMode::Bounded)});
+            report_results(
+                "true_contains" + suffix,
+                " true contains at load " + load + ":", num_keys, kNumTries,
+                repetition,
+                {time_contains("Hopscotch shadow probe", table, keys,
+                               LookupMode::Probe),
+                 time_contains("Hopscotch shadow bounded", table, keys,
+                               LookupMode::Bounded)});
+        }
+    }
+}
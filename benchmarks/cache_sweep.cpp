@@ -0,0 +1,265 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "key_sets.h"
+#include "table_adapters.h"
+
+using std::cout;
+using std::endl;
+using std::pair;
+using std::string;
+using std::vector;
+
+using google::dense_hash_set;
+using google::sparse_hash_set;
+
+namespace {
+
+// rough footprint of a key inside a table, including empty slots and metadata
+// used only to decide which cache level a working set should fit in
+const size_t kBytesPerKey = 16;
+const int kMaxKeys = 16'000'000;
+const long long kContainsOpsPerPoint = 4'000'000;
+const long long kInsertOpsPerPoint = 1'000'000;
+
+size_t read_sysfs_cache_size(int level) {
+    // fallback for libcs without _SC_LEVEL*_CACHE_SIZE
+    for (int index = 0; index < 8; ++index) {
+        string dir = "/sys/devices/system/cpu/cpu0/cache/index" +
+                     std::to_string(index) + "/";
+        std::ifstream level_file(dir + "level");
+        std::ifstream type_file(dir + "type");
+        std::ifstream size_file(dir + "size");
+        if (!level_file || !type_file || !size_file) break;
+        int this_level = 0;
+        string type;
+        string size;
+        level_file >> this_level;
+        type_file >> type;
+        size_file >> size;
+        if (this_level != level || type == "Instruction") continue;
+        size_t res = std::stoull(size);
+        if (!size.empty() && (size.back() == 'K' || size.back() == 'k')) {
+            res *= 1024;
+        } else if (!size.empty() && size.back() == 'M') {
+            res *= 1024 * 1024;
+        }
+        return res;
+    }
+    return 0;
+}
+
+size_t cache_size(int level, size_t fallback) {
+    long res = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    if (level == 1) res = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    if (level == 2) res = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (level == 3) res = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    if (res > 0) return static_cast<size_t>(res);
+    size_t from_sysfs = read_sysfs_cache_size(level);
+    return from_sysfs ? from_sysfs : fallback;
+}
+
+struct SweepPoint {
+    int num_keys;
+    string label;  // which level this working set is meant to hit
+};
+
+vector<SweepPoint> make_sweep_points(size_t l1, size_t l2, size_t llc) {
+    // geometric grid between half of L1 and 4x LLC, to be able to see crossovers,
+    // plus reference points placed in the middle of every level
+    vector<SweepPoint> res;
+    auto label_of = [&](size_t bytes) -> string {
+        if (bytes <= l1) return "L1";
+        if (bytes <= l2) return "L2";
+        if (bytes <= llc) return "LLC";
+        return "DRAM";
+    };
+    for (size_t bytes = l1 / 2; bytes <= 4 * llc; bytes *= 2) {
+        int num_keys = static_cast<int>(
+            std::min<size_t>(bytes / kBytesPerKey, kMaxKeys));
+        res.push_back({num_keys, label_of(bytes)});
+    }
+    for (size_t bytes : {l1 / 2, l2 / 2, llc / 2, 4 * llc}) {
+        int num_keys = static_cast<int>(
+            std::min<size_t>(bytes / kBytesPerKey, kMaxKeys));
+        res.push_back({num_keys, label_of(bytes)});
+    }
+    std::ranges::sort(res, {}, &SweepPoint::num_keys);
+    auto last = std::ranges::unique(res, {}, &SweepPoint::num_keys);
+    res.erase(last.begin(), last.end());
+    std::erase_if(res, [](const SweepPoint& p) { return p.num_keys < 16; });
+    return res;
+}
+
+// ns per op for every (op, table, num_keys), summed over repetitions
+// the inner map is ordered by num_keys -- used to find crossovers
+std::map<string, std::map<string, std::map<int, pair<double, int>>>>
+    ns_per_op{};
+
+void add_ns_per_op(const string& op, const string& name, int num_keys,
+                   double ns) {
+    auto& [sum, count] = ns_per_op[op][name][num_keys];
+    sum += ns;
+    ++count;
+}
+
+template <class Table>
+TableTiming bench_insert(const string& name, const string& op,
+                         const vector<int>& keys, int num_tries) {
+    double load_factor = 0.0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_tries; ++i) {
+        Table table{};
+        prepare_table(table);
+        for (int v : keys) {
+            insert_key(table, v);
+        }
+        load_factor = table.load_factor();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> time = end - begin;
+    add_ns_per_op(
+        op, name, static_cast<int>(keys.size()),
+        time.count() * 1e6 / (static_cast<double>(keys.size()) * num_tries));
+    return {name, time, load_factor};
+}
+
+template <class Table>
+TableTiming bench_contains(const string& name, const string& op,
+                           const vector<int>& keys,
+                           const vector<int>& lookups, int num_tries) {
+    Table table{};
+    prepare_table(table);
+    for (int v : keys) {
+        insert_key(table, v);
+    }
+    int counter = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_tries; ++i) {
+        for (int v : lookups) {
+            counter += contains_key(table, v);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> time = end - begin;
+    add_ns_per_op(
+        op, name, static_cast<int>(keys.size()),
+        time.count() * 1e6 / (static_cast<double>(lookups.size()) * num_tries));
+    return {name, time, table.load_factor(), counter};
+}
+
+void bench_sweep_point(const SweepPoint& point, int repetition) {
+    int n = point.num_keys;
+    std::mt19937 rng = make_bench_rng(n, -1, repetition);
+    vector<int> keys = unique_keys(n, rng);
+    int contains_tries = static_cast<int>(
+        std::max<long long>(1, kContainsOpsPerPoint / n));
+    int insert_tries =
+        static_cast<int>(std::max<long long>(1, kInsertOpsPerPoint / n));
+
+    // sequential order -- ascending keys, random order -- shuffled keys
+    vector<int> sequential = keys;
+    std::ranges::sort(sequential);
+    vector<int> random = keys;
+    std::ranges::shuffle(random, rng);
+
+    for (const auto& [order, ordered] :
+         {pair<string, const vector<int>&>{"sequential", sequential},
+          pair<string, const vector<int>&>{"random", random}}) {
+        string op = "insert_" + order;
+        report_results(
+            op, " inserts, " + order + " order (" + point.label + "):", n,
+            insert_tries, repetition,
+            {bench_insert<sparse_hash_set<int>>("Sparse_hash_set", op, ordered,
+                                                insert_tries),
+             bench_insert<dense_hash_set<int>>("Dense_hash_set", op, ordered,
+                                               insert_tries),
+             bench_insert<HopscotchShadow<int>>("Hopscotch shadow", op,
+                                                ordered, insert_tries),
+             bench_insert<HopscotchHashSet<int>>("Hopscotch bitmaps", op,
+                                                 ordered, insert_tries)});
+
+        op = "contains_" + order;
+        report_results(
+            op, " true contains, " + order + " order (" + point.label + "):",
+            n, contains_tries, repetition,
+            {bench_contains<sparse_hash_set<int>>("Sparse_hash_set", op, keys,
+                                                  ordered, contains_tries),
+             bench_contains<dense_hash_set<int>>("Dense_hash_set", op, keys,
+                                                 ordered, contains_tries),
+             bench_contains<HopscotchShadow<int>>("Hopscotch shadow", op, keys,
+                                                  ordered, contains_tries),
+             bench_contains<HopscotchHashSet<int>>(
+                 "Hopscotch bitmaps", op, keys, ordered, contains_tries)});
+    }
+}
+
+vector<pair<int, double>> averaged(
+    const std::map<int, pair<double, int>>& by_size) {
+    vector<pair<int, double>> res;
+    for (const auto& [num_keys, sum_and_count] : by_size) {
+        res.push_back({num_keys, sum_and_count.first / sum_and_count.second});
+    }
+    return res;
+}
+
+void print_crossovers() {
+    // crossover -- the pair of neighbouring sizes where two tables swap places
+    cout << "Crossover points (ns/op):" << endl;
+    for (const auto& [op, by_table] : ns_per_op) {
+        for (auto a = by_table.begin(); a != by_table.end(); ++a) {
+            for (auto b = std::next(a); b != by_table.end(); ++b) {
+                vector<pair<int, double>> first = averaged(a->second);
+                vector<pair<int, double>> second = averaged(b->second);
+                for (size_t i = 1; i < first.size() && i < second.size(); ++i) {
+                    bool was_faster = first[i - 1].second < second[i - 1].second;
+                    bool is_faster = first[i].second < second[i].second;
+                    if (was_faster == is_faster) continue;
+                    cout << op << ": " << (is_faster ? a->first : b->first)
+                         << " overtakes " << (is_faster ? b->first : a->first)
+                         << " between " << first[i - 1].first << " and "
+                         << first[i].first << " keys (" << first[i - 1].second
+                         << "/" << second[i - 1].second << " -> "
+                         << first[i].second << "/" << second[i].second << ")"
+                         << endl;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+void bench_cache_sweep() {
+    size_t l1 = cache_size(1, 32 * 1024);
+    size_t l2 = cache_size(2, 1024 * 1024);
+    size_t llc = cache_size(3, 32 * 1024 * 1024);
+    bool is_text = bench_config().format == OutputFormat::Text;
+    if (is_text) {
+        cout << "Detected caches: L1d " << l1 << "B, L2 " << l2 << "B, LLC "
+             << llc << "B, assuming " << kBytesPerKey << "B per key" << endl;
+    }
+    ns_per_op.clear();
+    vector<SweepPoint> points = make_sweep_points(l1, l2, llc);
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (const auto& point : points) {
+            bench_sweep_point(point, repetition);
+        }
+    }
+    if (is_text) {
+        print_crossovers();
+    }
+}
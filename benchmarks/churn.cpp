@@ -0,0 +1,155 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+using google::sparse_hash_set;
+
+namespace {
+
+const int kNumRounds = 8;
+
+// murmur3 finalizer, a bijection, so distinct inputs give distinct keys
+uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// endless supply of distinct non-negative keys
+struct KeyStream {
+    uint32_t next = 0;
+    int operator()() {
+        while (true) {
+            int res = static_cast<int>(fmix32(next++));
+            if (res >= 0) return res;
+        }
+    }
+};
+
+// every round erases each live key once on average and inserts as many new ones
+struct ChurnPlan {
+    vector<int> initial{};
+    vector<vector<pair<int, int>>> rounds{};  // {key to erase, key to insert}
+    vector<vector<int>> live_after{};         // live keys after each round
+    vector<int> misses{};                     // never inserted
+};
+
+ChurnPlan make_plan(int size, std::mt19937& rng) {
+    ChurnPlan plan{};
+    KeyStream stream{};
+    for (int i = 0; i < size; ++i) {
+        plan.initial.push_back(stream());
+    }
+    vector<int> live = plan.initial;
+    std::uniform_int_distribution<int> distrib(0, size - 1);
+    for (int round = 0; round < kNumRounds; ++round) {
+        vector<pair<int, int>> ops{};
+        ops.reserve(size);
+        for (int i = 0; i < size; ++i) {
+            int& victim = live[distrib(rng)];
+            ops.push_back({victim, stream()});
+            victim = ops.back().second;
+        }
+        plan.rounds.push_back(std::move(ops));
+        plan.live_after.push_back(live);
+    }
+    for (int i = 0; i < size; ++i) {
+        plan.misses.push_back(stream());
+    }
+    return plan;
+}
+
+template <class Table>
+void set_mode(Table& table, [[maybe_unused]] EraseMode mode) {
+    if constexpr (requires { table.set_erase_mode(mode); }) {
+        table.set_erase_mode(mode);
+    }
+}
+
+// runs the whole plan on one table
+// returns {churn, true contains, false contains} for every round
+template <class Table>
+vector<vector<TableTiming>> run_plan(const string& name, const ChurnPlan& plan,
+                                     EraseMode mode) {
+    Table table{};
+    prepare_table(table);
+    set_mode(table, mode);
+    for (int v : plan.initial) {
+        insert_key(table, v);
+    }
+    vector<vector<TableTiming>> res{};
+    for (size_t round = 0; round < plan.rounds.size(); ++round) {
+        auto begin = std::chrono::steady_clock::now();
+        for (auto [to_erase, to_insert] : plan.rounds[round]) {
+            erase_key(table, to_erase);
+            insert_key(table, to_insert);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double load_factor = table.load_factor();
+        TableTiming churn{name, end - begin, load_factor};
+
+        int counter = 0;
+        begin = std::chrono::steady_clock::now();
+        for (int v : plan.live_after[round]) {
+            counter += contains_key(table, v);
+        }
+        end = std::chrono::steady_clock::now();
+        TableTiming hits{name, end - begin, load_factor, counter};
+
+        counter = 0;
+        begin = std::chrono::steady_clock::now();
+        for (int v : plan.misses) {
+            counter += contains_key(table, v);
+        }
+        end = std::chrono::steady_clock::now();
+        TableTiming misses{name, end - begin, load_factor, counter};
+        res.push_back({churn, hits, misses});
+    }
+    return res;
+}
+
+}  // namespace
+
+void bench_churn() {
+    const int size = 1'000'000;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        std::mt19937 rng = make_bench_rng(size, 500, repetition);
+        ChurnPlan plan = make_plan(size, rng);
+        vector<vector<vector<TableTiming>>> by_table{
+            run_plan<sparse_hash_set<int>>("Sparse_hash_set", plan,
+                                           EraseMode::Tombstone),
+            run_plan<HopscotchShadow<int>>("Hopscotch shadow tombstone", plan,
+                                           EraseMode::Tombstone),
+            run_plan<HopscotchShadow<int>>("Hopscotch shadow backward shift",
+                                           plan, EraseMode::BackwardShift)};
+        for (int round = 0; round < kNumRounds; ++round) {
+            string suffix = "_round_" + std::to_string(round + 1);
+            string header = " keys, round " + std::to_string(round + 1) +
+                            " of " + std::to_string(kNumRounds) + ", ";
+            const vector<pair<string, string>> ops{
+                {"churn", "erase + insert pairs:"},
+                {"true_contains_after_churn", "true contains:"},
+                {"false_contains_after_churn", "false contains:"}};
+            for (size_t op = 0; op < ops.size(); ++op) {
+                vector<TableTiming> timings{};
+                for (const auto& table_rounds : by_table) {
+                    timings.push_back(table_rounds[round][op]);
+                }
+                report_results(ops[op].first + suffix, header + ops[op].second,
+                               size, 1, repetition, timings);
+            }
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "hopscotch_counting.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const int kNumDistinct = 1'000'000;
+const int kNumLookups = 1'000'000;
+
+// murmur3 finalizer, a bijection, so distinct ranks give distinct keys
+uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+int key_of_rank(uint32_t rank) { return static_cast<int>(fmix32(rank)); }
+
+// stream of keys where the key of rank r comes up with probability ~ 1 / r^s
+vector<int> make_zipf_stream(int length, double s, std::mt19937& rng) {
+    vector<double> cdf(kNumDistinct);
+    double sum = 0.0;
+    for (int r = 0; r < kNumDistinct; ++r) {
+        sum += 1.0 / std::pow(r + 1, s);
+        cdf[r] = sum;
+    }
+    std::uniform_real_distribution<double> distrib(0.0, sum);
+    vector<int> res(length);
+    for (int& v : res) {
+        auto rank = std::ranges::lower_bound(cdf, distrib(rng)) - cdf.begin();
+        rank = std::min<ptrdiff_t>(rank, kNumDistinct - 1);
+        v = key_of_rank(static_cast<uint32_t>(rank));
+    }
+    return res;
+}
+
+struct CountingAdapter {
+    HopscotchCountingSet<int> table{};
+    void add(int key) { table.increment(key); }
+    uint64_t count(int key) const { return table.count(key); }
+    double load_factor() const { return table.load_factor(); }
+};
+
+struct MapAdapter {
+    std::unordered_map<int, uint32_t> table{};
+    void add(int key) { ++table[key]; }
+    uint64_t count(int key) const {
+        auto it = table.find(key);
+        return it == table.end() ? 0 : it->second;
+    }
+    double load_factor() const { return table.load_factor(); }
+};
+
+struct MultisetAdapter {
+    std::unordered_multiset<int> table{};
+    void add(int key) { table.insert(key); }
+    uint64_t count(int key) const { return table.count(key); }
+    double load_factor() const { return table.load_factor(); }
+};
+
+// returns {counting the stream, count() of every lookup}
+template <class Adapter>
+vector<TableTiming> time_adapter(const string& name, const vector<int>& stream,
+                                 const vector<int>& lookups) {
+    Adapter adapter{};
+    auto begin = std::chrono::steady_clock::now();
+    for (int v : stream) {
+        adapter.add(v);
+    }
+    auto end = std::chrono::steady_clock::now();
+    TableTiming add{name, end - begin, adapter.load_factor()};
+
+    uint64_t total = 0;
+    begin = std::chrono::steady_clock::now();
+    for (int v : lookups) {
+        total += adapter.count(v);
+    }
+    end = std::chrono::steady_clock::now();
+    // sum of counts, the same for every table
+    TableTiming count{name, end - begin, adapter.load_factor(),
+                      static_cast<int>(total % 1'000'000'007)};
+    return {add, count};
+}
+
+}  // namespace
+
+void bench_counting() {
+    const int length = 10'000'000;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (double s : {0.8, 1.0, 1.2}) {
+            int s_percent = static_cast<int>(std::lround(s * 100));
+            std::mt19937 rng = make_bench_rng(length, 700 + s_percent,
+                                              repetition);
+            vector<int> stream = make_zipf_stream(length, s, rng);
+            // every rank is equally likely, keys picked from the stream would
+            // be the hot ones, and unordered_multiset::count is linear in them
+            vector<int> lookups(kNumLookups);
+            std::uniform_int_distribution<uint32_t> pick(0, kNumDistinct - 1);
+            for (int& v : lookups) {
+                v = key_of_rank(pick(rng));
+            }
+            vector<vector<TableTiming>> by_table{
+                time_adapter<CountingAdapter>("Hopscotch counting", stream,
+                                              lookups),
+                time_adapter<MapAdapter>("Unordered_map", stream, lookups),
+                time_adapter<MultisetAdapter>("Unordered_multiset", stream,
+                                              lookups)};
+            string suffix = "_zipf_" + std::to_string(s_percent);
+            string skew = std::to_string(s).substr(0, 3);
+            const vector<pair<string, string>> ops{
+                {"count_stream", " keys counted, zipf s = " + skew + ":"},
+                {"count_lookup",
+                 " keys counted, count() of random ranks, zipf s = " + skew +
+                     ":"}};
+            for (size_t op = 0; op < ops.size(); ++op) {
+                vector<TableTiming> timings{};
+                for (const auto& table_timings : by_table) {
+                    timings.push_back(table_timings[op]);
+                }
+                report_results(ops[op].first + suffix, ops[op].second, length,
+                               1, repetition, timings);
+            }
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "dedup.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// murmur3 64-bit finalizer, distinct indices give distinct keys
+uint64_t key_of(uint64_t i) {
+    uint64_t h = i + 1;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+std::filesystem::path data_dir() {
+    const string& dir = bench_config().data_dir;
+    return dir.empty() ? std::filesystem::temp_directory_path()
+                       : std::filesystem::path(dir);
+}
+
+// counter is the number of unique keys
+template <class Table>
+TableTiming time_dedup(const string& name, Table& table,
+                       const std::filesystem::path& input) {
+    auto begin = std::chrono::steady_clock::now();
+    DedupStats stats = dedup_files(table, {input.string()}, [](uint64_t) {});
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, table.load_factor(),
+            static_cast<int>(stats.num_unique)};
+}
+
+// the same keys as decimal lines, what sort -u can read
+TableTiming time_sort(const std::filesystem::path& input) {
+    string command = "LC_ALL=C sort -u '" + input.string() + "' | wc -l";
+    auto begin = std::chrono::steady_clock::now();
+    FILE* pipe = popen(command.c_str(), "r");
+    long num_unique = -1;
+    if (pipe) {
+        if (fscanf(pipe, "%ld", &num_unique) != 1) num_unique = -1;
+        pclose(pipe);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {"sort -u", end - begin, 0.0, static_cast<int>(num_unique)};
+}
+
+}  // namespace
+
+void bench_dedup() {
+    std::filesystem::path dir = data_dir();
+    string prefix = "hopscotch_dedup_" + std::to_string(getpid());
+    std::filesystem::path binary = dir / (prefix + ".bin");
+    std::filesystem::path text = dir / (prefix + ".txt");
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        // every key comes up twice on average
+        for (int size : {1'000'000, 10'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 1200, repetition);
+            std::uniform_int_distribution<uint64_t> pick(0, size / 2 - 1);
+            {
+                std::ofstream binary_out(binary, std::ios::binary);
+                std::ofstream text_out(text);
+                for (int i = 0; i < size; ++i) {
+                    uint64_t key = key_of(pick(rng));
+                    binary_out.write(reinterpret_cast<const char*>(&key),
+                                     sizeof(key));
+                    text_out << key << '\n';
+                }
+            }
+            // like the dedup tool
+            DedupShadow<uint64_t> shadow{};
+            shadow.set_erase_mode(EraseMode::BackwardShift);
+            HopscotchHashSet<uint64_t> bitmaps{};
+            vector<TableTiming> timings = {
+                time_dedup("Hopscotch shadow", shadow, binary),
+                time_dedup("Hopscotch bitmaps", bitmaps, binary),
+                time_sort(text)};
+            report_results("dedup",
+                           " 8-byte keys from a file, half of them repeats "
+                           "(counter = unique keys):",
+                           size, 1, repetition, timings);
+        }
+    }
+    std::filesystem::remove(binary);
+    std::filesystem::remove(text);
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "key_sets.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// one key in four, spread over the whole table
+bool is_expired(int key) { return key % 4 == 0; }
+
+// what callers did before erase_if: collect, then a lookup per key; in slot
+// order, the best case, and shuffled, like keys from an expiry list
+template <class Table>
+TableTiming time_per_key(const string& name, Table table, bool is_shuffled) {
+    auto begin = std::chrono::steady_clock::now();
+    vector<int> expired{};
+    table.for_each_key(0, table.bucket_count(), [&](int key) {
+        if (is_expired(key)) expired.push_back(key);
+    });
+    if (is_shuffled) {
+        std::ranges::shuffle(expired, std::mt19937(1));
+    }
+    for (int key : expired) {
+        if constexpr (requires { table.erase(key); }) {
+            table.erase(key);
+        } else {
+            table.remove(key);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name + (is_shuffled ? " per key shuffled" : " per key"),
+            end - begin, table.load_factor(),
+            static_cast<int>(expired.size())};
+}
+
+template <class Table>
+TableTiming time_erase_if(const string& name, Table table,
+                          unsigned num_threads) {
+    auto begin = std::chrono::steady_clock::now();
+    auto num_erased = table.erase_if(is_expired, num_threads);
+    auto end = std::chrono::steady_clock::now();
+    return {name + " erase_if " + std::to_string(num_threads), end - begin,
+            table.load_factor(), static_cast<int>(num_erased)};
+}
+
+template <class Table>
+void add_timings(vector<TableTiming>& timings, const string& name,
+                 const Table& table) {
+    unsigned num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    timings.push_back(time_per_key(name, table, false));
+    timings.push_back(time_per_key(name, table, true));
+    timings.push_back(time_erase_if(name, table, 1));
+    if (num_threads > 1) {
+        timings.push_back(time_erase_if(name, table, num_threads));
+    }
+}
+
+}  // namespace
+
+void bench_erase_if() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int size : {1'000'000, 10'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 1500, repetition);
+            KeySet keys(size, 0, rng);
+            vector<TableTiming> timings{};
+            {
+                HopscotchShadow<int> tombstones{};
+                tombstones.set_deleted_key(-1);
+                HopscotchShadow<int> shift{};
+                shift.set_erase_mode(EraseMode::BackwardShift);
+                for (int key : keys.hits()) {
+                    tombstones.insert(key);
+                    shift.insert(key);
+                }
+                add_timings(timings, "Hopscotch shadow", tombstones);
+                add_timings(timings, "Hopscotch shadow backward shift", shift);
+            }
+            {
+                HopscotchHashSet<int> bitmaps{};
+                for (int key : keys.hits()) {
+                    bitmaps.add(key);
+                }
+                add_timings(timings, "Hopscotch bitmaps", bitmaps);
+            }
+            report_results("erase_if",
+                           " keys in the table, a quarter of them erased "
+                           "(counter = keys erased):",
+                           size, 1, repetition, timings);
+        }
+    }
+}
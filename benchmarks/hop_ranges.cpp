@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "hopscotch_bitmaps.h"
+#include "key_sets.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const uint32_t kFillTableSize = 1 << 16;
+const int kFillTrials = 5;
+
+// fills a table of fixed size until the first failed add
+// time is the whole fill, load factor and counter (keys fitted) are averaged over trials
+template <uint32_t HopRange>
+TableTiming fill_until_failure(const vector<int>& keys, std::mt19937& rng) {
+    double load_factor_sum = 0.0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int trial = 0; trial < kFillTrials; ++trial) {
+        HopscotchHashSet<int, HopRange> table{};
+        table.init(kFillTableSize, rng());
+        table.allow_resize(false);
+        try {
+            for (int v : keys) {
+                table.add(v);
+            }
+        } catch (const std::runtime_error&) {
+            // table is as full as it gets
+        }
+        load_factor_sum += table.load_factor();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double load_factor = load_factor_sum / kFillTrials;
+    return {std::to_string(HopRange) + "-slot neighborhood", end - begin,
+            load_factor, static_cast<int>(load_factor * kFillTableSize)};
+}
+
+template <uint32_t HopRange>
+TableTiming time_lookups(const vector<int>& keys, const vector<int>& lookups,
+                         int num_tries) {
+    HopscotchHashSet<int, HopRange> table{};
+    for (int v : keys) {
+        table.add(v);
+    }
+    int size = static_cast<int>(lookups.size());
+    int counter = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_tries * size; ++i) {
+        counter += table.contains(lookups[i % size]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {std::to_string(HopRange) + "-slot neighborhood", end - begin,
+            table.load_factor(), counter};
+}
+
+// inserts into a fixed-size table in bands of load factor, the last band ends at the first failure
+template <uint32_t HopRange>
+void time_insert_bands(uint32_t table_size, const vector<int>& keys,
+                       int repetition) {
+    HopscotchHashSet<int, HopRange> table{};
+    table.init(table_size, default_seed);
+    table.allow_resize(false);
+    size_t next_key = 0;
+    bool is_full = false;
+    for (int band = 1; band <= 10 && !is_full; ++band) {
+        size_t band_end = static_cast<size_t>(table_size) * band / 10;
+        size_t band_begin = next_key;
+        auto begin = std::chrono::steady_clock::now();
+        try {
+            for (; next_key < band_end; ++next_key) {
+                table.add(keys[next_key]);
+            }
+        } catch (const std::runtime_error&) {
+            is_full = true;
+        }
+        auto end = std::chrono::steady_clock::now();
+        if (next_key == band_begin) break;
+        // normalize to a full band, so bands are comparable
+        std::chrono::duration<double, std::milli> time =
+            (end - begin) * (static_cast<double>(table_size) / 10 /
+                             static_cast<double>(next_key - band_begin));
+        report_results("insert_load_factor_band_" + std::to_string(band),
+                       " slots, inserts up to load factor " +
+                           std::to_string(band / 10.0) +
+                           " (time per 10% of slots):",
+                       static_cast<int>(table_size), 1, repetition,
+                       {{std::to_string(HopRange) + "-slot neighborhood", time,
+                         table.load_factor(), static_cast<int>(next_key)}});
+    }
+}
+
+}  // namespace
+
+void bench_high_load_inserts() {
+    const uint32_t table_size = 1 << 20;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        std::mt19937 rng = make_bench_rng(table_size, 202, repetition);
+        vector<int> keys = unique_keys(table_size, rng);
+        time_insert_bands<32>(table_size, keys, repetition);
+        time_insert_bands<64>(table_size, keys, repetition);
+    }
+}
+
+void bench_hop_ranges() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        std::mt19937 rng = make_bench_rng(kFillTableSize, 200, repetition);
+        vector<int> fill_keys = unique_keys(kFillTableSize, rng);
+        report_results("max_load_factor", " slots filled until first failure:",
+                       kFillTableSize, kFillTrials, repetition,
+                       {fill_until_failure<8>(fill_keys, rng),
+                        fill_until_failure<16>(fill_keys, rng),
+                        fill_until_failure<32>(fill_keys, rng),
+                        fill_until_failure<64>(fill_keys, rng)});
+
+        vector<pair<int, int>> benches{{100'000, 20}, {1'000'000, 5}};
+        for (auto [size, num_tries] : benches) {
+            rng = make_bench_rng(size, 201, repetition);
+            vector<int> all_keys = unique_keys(2 * size, rng);
+            vector<int> keys(all_keys.begin(), all_keys.begin() + size);
+            vector<int> misses(all_keys.begin() + size, all_keys.end());
+            report_results("hop_range_true_contains", " true contains:", size,
+                           num_tries, repetition,
+                           {time_lookups<8>(keys, keys, num_tries),
+                            time_lookups<16>(keys, keys, num_tries),
+                            time_lookups<32>(keys, keys, num_tries),
+                            time_lookups<64>(keys, keys, num_tries)});
+            report_results("hop_range_false_contains", " false contains:",
+                           size, num_tries, repetition,
+                           {time_lookups<8>(keys, misses, num_tries),
+                            time_lookups<16>(keys, misses, num_tries),
+                            time_lookups<32>(keys, misses, num_tries),
+                            time_lookups<64>(keys, misses, num_tries)});
+        }
+    }
+}
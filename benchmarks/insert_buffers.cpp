@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "insert_buffers.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// producer p inserts keys[p], all of them start together
+template <class Run>
+std::chrono::duration<double, std::milli> time_producers(
+    const vector<vector<int>>& keys, Run&& run) {
+    vector<std::thread> producers{};
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t producer = 0; producer < keys.size(); ++producer) {
+        producers.emplace_back([&, producer] { run(keys[producer]); });
+    }
+    for (auto& thread : producers) {
+        thread.join();
+    }
+    return std::chrono::steady_clock::now() - begin;
+}
+
+template <class Table>
+TableTiming time_locked(const string& name, const vector<vector<int>>& keys) {
+    Table table{};
+    prepare_table(table);
+    std::mutex mutex{};
+    auto time = time_producers(keys, [&](const vector<int>& part) {
+        for (int key : part) {
+            std::lock_guard<std::mutex> lock(mutex);
+            insert_key(table, key);
+        }
+    });
+    return {name + " mutex per insert", time, table.load_factor()};
+}
+
+template <class Table>
+TableTiming time_buffered(const string& name, const vector<vector<int>>& keys,
+                          size_t batch_size) {
+    Table table{};
+    prepare_table(table);
+    InsertBuffers<Table> buffers(table, batch_size);
+    auto time = time_producers(keys, [&](const vector<int>& part) {
+        auto producer = buffers.make_producer();
+        for (int key : part) {
+            producer.insert(key);
+        }
+        producer.flush();
+    });
+    return {name + " buffers of " + std::to_string(batch_size), time,
+            table.load_factor()};
+}
+
+template <class Table>
+void bench_table(const string& name, const vector<vector<int>>& keys,
+                 int size, int repetition) {
+    report_results("multi_producer_insert",
+                   " keys inserted by " + std::to_string(keys.size()) +
+                       " producer threads:",
+                   size, 1, repetition,
+                   {time_locked<Table>(name, keys),
+                    time_buffered<Table>(name, keys, 256),
+                    time_buffered<Table>(name, keys, 4096)});
+}
+
+}  // namespace
+
+void bench_insert_buffers() {
+    unsigned num_producers =
+        std::max(4u, std::thread::hardware_concurrency());
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int size : {1'000'000, 4'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 1100, repetition);
+            std::uniform_int_distribution<int> dist(0, (1 << 30) - 1);
+            vector<vector<int>> keys(num_producers);
+            for (int i = 0; i < size; ++i) {
+                keys[i % num_producers].push_back(dist(rng));
+            }
+            bench_table<HopscotchShadow<int>>("Hopscotch shadow", keys, size,
+                                              repetition);
+            bench_table<HopscotchHashSet<int>>("Hopscotch bitmaps", keys,
+                                               size, repetition);
+        }
+    }
+}
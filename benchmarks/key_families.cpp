@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "table_adapters.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::unordered_set;
+using std::vector;
+
+using google::dense_hash_set;
+using google::sparse_hash_set;
+
+// 16-byte UUID-like key
+struct Uuid16 {
+    uint64_t hi;
+    uint64_t lo;
+    bool operator==(const Uuid16&) const = default;
+};
+
+// 64-byte composite key
+struct Wide64 {
+    std::array<uint64_t, 8> words;
+    bool operator==(const Wide64&) const = default;
+};
+
+// every table gets this hasher, so the comparison doesn't depend on std::hash quality
+// fnv1a is also what HopscotchHashSet uses inside, which can't take a custom hasher
+struct Fnv1aHash {
+    size_t operator()(const string& key) const {
+        return fnv1a(key.data(), key.size(), default_seed);
+    }
+    template <class Key>
+        requires std::is_trivially_copyable_v<Key>
+    size_t operator()(const Key& key) const {
+        return fnv1a(&key, sizeof(key), default_seed);
+    }
+};
+
+// generated strings are never empty and generated structs never have hi == 0
+template <>
+struct BenchSentinels<string> {
+    static string empty_key() { return ""; }
+    static string deleted_key() { return string(1, '\0'); }
+};
+
+template <>
+struct BenchSentinels<Uuid16> {
+    static Uuid16 empty_key() { return {0, 1}; }
+    static Uuid16 deleted_key() { return {0, 2}; }
+};
+
+template <>
+struct BenchSentinels<Wide64> {
+    static Wide64 empty_key() { return {{0, 1}}; }
+    static Wide64 deleted_key() { return {{0, 2}}; }
+};
+
+namespace {
+
+enum class Family { ShortSso, ShortHeap, LongString, Uuid, Wide };
+
+string random_string(size_t length, std::mt19937_64& rng) {
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::uniform_int_distribution<size_t> distrib(0, sizeof(alphabet) - 2);
+    string res(length, ' ');
+    for (char& c : res) c = alphabet[distrib(rng)];
+    return res;
+}
+
+template <class Key>
+Key random_key(Family family, std::mt19937_64& rng) {
+    if constexpr (std::is_same_v<Key, string>) {
+        // libstdc++ keeps up to 15 chars inline
+        switch (family) {
+            case Family::ShortSso:
+                return random_string(12, rng);
+            case Family::ShortHeap:
+                return random_string(24, rng);
+            default:
+                return random_string(256, rng);
+        }
+    } else if constexpr (std::is_same_v<Key, Uuid16>) {
+        return {rng() | 1, rng()};
+    } else {
+        Wide64 res{};
+        for (auto& w : res.words) w = rng();
+        res.words[0] |= 1;
+        return res;
+    }
+}
+
+// unique hits and disjoint misses, both shuffled
+template <class Key>
+pair<vector<Key>, vector<Key>> make_key_sets(Family family, int size,
+                                             std::mt19937_64& rng) {
+    unordered_set<Key, Fnv1aHash> elems{};
+    while (static_cast<int>(elems.size()) < size) {
+        elems.insert(random_key<Key>(family, rng));
+    }
+    unordered_set<Key, Fnv1aHash> false_elems{};
+    while (static_cast<int>(false_elems.size()) < size) {
+        Key guess = random_key<Key>(family, rng);
+        if (!elems.contains(guess)) false_elems.insert(guess);
+    }
+    vector<Key> keys(elems.begin(), elems.end());
+    vector<Key> misses(false_elems.begin(), false_elems.end());
+    std::ranges::shuffle(keys, rng);
+    std::ranges::shuffle(misses, rng);
+    return {keys, misses};
+}
+
+template <class Table, class Key>
+TableTiming time_insert(const string& name, const vector<Key>& keys,
+                        int num_tries) {
+    double load_factor = 0.0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_tries; ++i) {
+        Table table{};
+        prepare_table(table);
+        for (const Key& k : keys) {
+            insert_key(table, k);
+        }
+        load_factor = table.load_factor();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, load_factor};
+}
+
+template <class Table, class Key>
+TableTiming time_remove(const string& name, const vector<Key>& keys,
+                        const vector<Key>& order, int num_tries) {
+    vector<Table> tables(num_tries);
+    for (auto& table : tables) {
+        prepare_table(table);
+        for (const Key& k : keys) {
+            insert_key(table, k);
+        }
+    }
+    double load_factor = tables.empty() ? 0.0 : tables[0].load_factor();
+    auto begin = std::chrono::steady_clock::now();
+    for (auto& table : tables) {
+        for (const Key& k : order) {
+            erase_key(table, k);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, load_factor};
+}
+
+template <class Table, class Key>
+TableTiming time_contains(const string& name, const vector<Key>& keys,
+                          const vector<Key>& lookups, int num_tries) {
+    Table table{};
+    prepare_table(table);
+    for (const Key& k : keys) {
+        insert_key(table, k);
+    }
+    int size = static_cast<int>(lookups.size());
+    int counter = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_tries * size; ++i) {
+        counter += contains_key(table, lookups[i % size]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, table.load_factor(), counter};
+}
+
+template <class Table>
+struct TableTag {
+    using type = Table;
+};
+
+// calls time_table(TableTag<Table>{}, display_name) for every table that supports Key
+template <class Key, class TimeTable>
+vector<TableTiming> time_all_tables(TimeTable time_table) {
+    vector<TableTiming> res{
+        time_table(TableTag<unordered_set<Key, Fnv1aHash>>{}, "Unordered_set"),
+        time_table(TableTag<sparse_hash_set<Key, Fnv1aHash>>{},
+                   "Sparse_hash_set"),
+        time_table(TableTag<dense_hash_set<Key, Fnv1aHash>>{}, "Dense_hash_set"),
+        time_table(TableTag<HopscotchShadow<Key, Fnv1aHash>>{},
+                   "Hopscotch shadow"),
+        time_table(TableTag<HopscotchShadow<Key, Fnv1aHash,
+                                            PowerOfTwoGrowthPolicy, true>>{},
+                   "Hopscotch shadow stored hash")};
+    // HopscotchHashSet hashes raw bytes, so it can't hold std::string
+    if constexpr (std::is_trivially_copyable_v<Key>) {
+        res.push_back(
+            time_table(TableTag<HopscotchHashSet<Key>>{}, "Hopscotch bitmaps"));
+    }
+    return res;
+}
+
+template <class Key>
+void bench_family(Family family, const string& family_name, int size,
+                  int num_tries, int repetition) {
+    std::mt19937 seeder =
+        make_bench_rng(size, 100 + static_cast<int>(family), repetition);
+    std::mt19937_64 rng(seeder());
+    auto [keys, misses] = make_key_sets<Key>(family, size, rng);
+    vector<Key> remove_order = keys;
+    std::ranges::shuffle(remove_order, rng);
+
+    report_results(family_name + "_insert", " " + family_name + " inserts:",
+                   size, num_tries, repetition,
+                   time_all_tables<Key>([&](auto tag, const string& name) {
+                       using Table = typename decltype(tag)::type;
+                       return time_insert<Table>(name, keys, num_tries);
+                   }));
+    report_results(family_name + "_remove", " " + family_name + " removes:",
+                   size, num_tries, repetition,
+                   time_all_tables<Key>([&](auto tag, const string& name) {
+                       using Table = typename decltype(tag)::type;
+                       return time_remove<Table>(name, keys, remove_order,
+                                                 num_tries);
+                   }));
+    report_results(family_name + "_true_contains",
+                   " " + family_name + " true contains:", size, num_tries,
+                   repetition,
+                   time_all_tables<Key>([&](auto tag, const string& name) {
+                       using Table = typename decltype(tag)::type;
+                       return time_contains<Table>(name, keys, remove_order,
+                                                   num_tries);
+                   }));
+    report_results(family_name + "_false_contains",
+                   " " + family_name + " false contains:", size, num_tries,
+                   repetition,
+                   time_all_tables<Key>([&](auto tag, const string& name) {
+                       using Table = typename decltype(tag)::type;
+                       return time_contains<Table>(name, keys, misses,
+                                                   num_tries);
+                   }));
+}
+
+}  // namespace
+
+void bench_key_families() {
+    vector<pair<int, int>> benches{{10'000, 100}, {100'000, 10}, {1'000'000, 2}};
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (auto [size, num_tries] : benches) {
+            bench_family<string>(Family::ShortSso, "short_string_sso", size,
+                                 num_tries, repetition);
+            bench_family<string>(Family::ShortHeap, "short_string_heap", size,
+                                 num_tries, repetition);
+            bench_family<string>(Family::LongString, "long_string", size,
+                                 num_tries, repetition);
+            bench_family<Uuid16>(Family::Uuid, "uuid16", size, num_tries,
+                                 repetition);
+            bench_family<Wide64>(Family::Wide, "struct64", size, num_tries,
+                                 repetition);
+            if (bench_config().format == OutputFormat::Text) {
+                cout << "____________________" << endl;
+            }
+        }
+    }
+}
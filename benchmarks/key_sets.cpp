@@ -0,0 +1,132 @@
+#include "key_sets.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "bench_results.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// start of the counter and the mixer, what a key set is made from
+struct KeySource {
+    uint32_t start;
+    uint32_t mixer;
+};
+
+KeySource draw_source(std::mt19937& rng) {
+    uint32_t start = static_cast<uint32_t>(rng());
+    uint32_t mixer = static_cast<uint32_t>(rng());
+    return {start, mixer};
+}
+
+void fill_keys(int* out, size_t num_keys, KeySource source) {
+    for (size_t i = 0; i < num_keys; ++i) {
+        out[i] = static_cast<int>(
+            mix31(source.start + static_cast<uint32_t>(i), source.mixer));
+    }
+}
+
+struct CacheHeader {
+    uint64_t magic;
+    uint64_t num_hits;
+    uint64_t num_misses;
+};
+constexpr uint64_t kCacheMagic = 0x4B45595345543031;  // "KEYSET01"
+
+}  // namespace
+
+vector<int> unique_keys(size_t num_keys, std::mt19937& rng) {
+    if (num_keys > (size_t{1} << 31)) {
+        throw std::runtime_error("Only 2^31 distinct keys to make");
+    }
+    vector<int> res(num_keys);
+    fill_keys(res.data(), num_keys, draw_source(rng));
+    return res;
+}
+
+KeySet::KeySet(size_t init_num_hits, size_t init_num_misses,
+               std::mt19937& rng)
+    : num_hits(init_num_hits), num_misses(init_num_misses) {
+    size_t num_keys = num_hits + num_misses;
+    if (num_keys > (size_t{1} << 31)) {
+        throw std::runtime_error("Only 2^31 distinct keys to make");
+    }
+    // misses continue the counter of hits, so they are other keys
+    KeySource source = draw_source(rng);
+    const string& dir = bench_config().dataset_cache;
+    string path{};
+    if (!dir.empty()) {
+        std::ostringstream name;
+        name << "keys_" << std::hex << source.start << "_" << source.mixer
+             << std::dec << "_" << num_hits << "_" << num_misses << ".bin";
+        path = (std::filesystem::path(dir) / name.str()).string();
+        if (map_cached(path)) return;
+    }
+    generated.resize(num_keys);
+    keys = generated.data();
+    fill_keys(keys, num_keys, source);
+    if (!path.empty()) write_cache(path);
+}
+
+KeySet::~KeySet() {
+    if (mapping) munmap(mapping, mapping_length);
+}
+
+bool KeySet::map_cached(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    size_t expected =
+        sizeof(CacheHeader) + (num_hits + num_misses) * sizeof(int);
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != expected) {
+        ::close(fd);
+        return false;
+    }
+    // private, so benches can shuffle the keys without touching the file
+    void* addr = mmap(nullptr, expected, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return false;
+    CacheHeader header;
+    std::memcpy(&header, addr, sizeof(header));
+    if (header.magic != kCacheMagic || header.num_hits != num_hits ||
+        header.num_misses != num_misses) {
+        munmap(addr, expected);
+        return false;
+    }
+    mapping = addr;
+    mapping_length = expected;
+    keys = reinterpret_cast<int*>(static_cast<char*>(addr) +
+                                  sizeof(CacheHeader));
+    return true;
+}
+
+void KeySet::write_cache(const string& path) const {
+    // written aside and renamed, so a killed run leaves no short file
+    string temp_path = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(temp_path, std::ios::binary);
+        CacheHeader header{kCacheMagic, num_hits, num_misses};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(keys),
+                  static_cast<std::streamsize>((num_hits + num_misses) *
+                                               sizeof(int)));
+        if (!out) {
+            throw std::runtime_error("can't write dataset cache " +
+                                     temp_path);
+        }
+    }
+    std::filesystem::rename(temp_path, path);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+// Key sets for benches, made in O(n) without a hash set: key i is a counter
+// value pushed through a bijection of [0, 2^31), so keys of distinct counter
+// values never collide and come out in random-looking order. The counter
+// start and the mixer constants come from the bench rng, so the same
+// --seed gives the same keys. Keys are non-negative, BenchSentinels are not.
+
+// bijection of [0, 2^31): an odd multiplier and xor-shifts right are both
+// invertible mod 2^31, key picks one of 2^31 such mixers
+inline uint32_t mix31(uint32_t x, uint32_t key) {
+    const uint32_t mask = 0x7FFFFFFFu;
+    x = (x ^ key) & mask;
+    x = (x * 0x2C1B3C6Du) & mask;
+    x ^= x >> 16;
+    x = (x * 0x297A2D39u) & mask;
+    x ^= x >> 15;
+    return x;
+}
+
+// num_keys distinct keys, in the order the mixer gives them
+std::vector<int> unique_keys(size_t num_keys, std::mt19937& rng);
+
+// keys of one bench point: hits go into tables, misses are none of them
+// generated, or mapped from --dataset-cache if the file is there; spans stay
+// valid while the KeySet lives, and can be shuffled in place
+class KeySet {
+   public:
+    KeySet(size_t num_hits, size_t num_misses, std::mt19937& rng);
+    ~KeySet();
+    KeySet(const KeySet&) = delete;
+    KeySet& operator=(const KeySet&) = delete;
+
+    std::span<int> hits() { return {keys, num_hits}; }
+    std::span<int> misses() { return {keys + num_hits, num_misses}; }
+
+   private:
+    // false if there is no usable file
+    bool map_cached(const std::string& path);
+    void write_cache(const std::string& path) const;
+
+    size_t num_hits;
+    size_t num_misses;
+    int* keys = nullptr;
+    std::vector<int> generated{};  // empty when mapped
+    void* mapping = nullptr;
+    size_t mapping_length = 0;
+};
@@ -0,0 +1,168 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// murmur3 finalizer, a bijection, so distinct indices give distinct keys
+// and only index 0 gives key 0
+uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// keys are never 0, so HopscotchShadow can keep its default deleted_key
+uint32_t key_of(uint64_t i) { return fmix32(static_cast<uint32_t>(i + 1)); }
+
+const uint64_t kNumLookups = 10'000'000;
+
+uint64_t physical_memory() {
+    return static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) *
+           static_cast<uint64_t>(sysconf(_SC_PAGE_SIZE));
+}
+
+// returns {insert of num_keys keys, kNumLookups contains, half of them hits}
+// policy is for tables that take one
+template <class Table>
+std::pair<TableTiming, TableTiming> time_table(
+    const string& name, uint64_t num_keys, double max_load,
+    const MemoryPolicy& policy = MemoryPolicy{}) {
+    Table table{};
+    if constexpr (requires { table.set_memory_policy(policy); }) {
+        table.set_memory_policy(policy);
+    }
+    table.max_load_factor(max_load);
+    table.reserve(static_cast<typename Table::size_type>(num_keys));
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < num_keys; ++i) {
+        insert_key(table, key_of(i));
+    }
+    auto end = std::chrono::steady_clock::now();
+    TableTiming insert{name, end - begin, table.load_factor()};
+
+    std::mt19937_64 rng(bench_config().seed);
+    std::uniform_int_distribution<uint64_t> pick(0, 2 * num_keys - 1);
+    int counter = 0;
+    begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < kNumLookups; ++i) {
+        counter += contains_key(table, key_of(pick(rng)));
+    }
+    end = std::chrono::steady_clock::now();
+    TableTiming contains{name, end - begin, table.load_factor(), counter};
+    return {insert, contains};
+}
+
+template <class Table32, class Table64>
+void bench_size_types(const string& name, uint64_t num_keys, double max_load,
+                      int repetition) {
+    auto [insert32, contains32] =
+        time_table<Table32>(name + " 32-bit", num_keys, max_load);
+    auto [insert64, contains64] =
+        time_table<Table64>(name + " 64-bit", num_keys, max_load);
+    report_results("insert_size_type", " keys inserted after reserve:",
+                   static_cast<int64_t>(num_keys), 1, repetition,
+                   {insert32, insert64});
+    report_results("contains_size_type",
+                   " keys, 10M contains, half of them hits:",
+                   static_cast<int64_t>(num_keys), 1, repetition,
+                   {contains32, contains64});
+}
+
+// slots past 2^32 only fit a 64-bit table, bytes_per_slot is a rough
+// estimate of what the table takes
+template <class Table>
+void bench_huge(const string& name, uint64_t num_keys, double max_load,
+                double bytes_per_slot, int repetition) {
+    uint64_t needed =
+        static_cast<uint64_t>(num_keys / max_load * bytes_per_slot);
+    if (needed > physical_memory() / 10 * 9) {
+        std::cerr << name << ": skipped, needs about " << (needed >> 30)
+                  << "GB of " << (physical_memory() >> 30) << "GB"
+                  << std::endl;
+        return;
+    }
+    auto [insert, contains] = time_table<Table>(name, num_keys, max_load);
+    report_results("insert_huge", " keys inserted after reserve, >2^32 slots:",
+                   static_cast<int64_t>(num_keys), 1, repetition, {insert});
+    report_results("contains_huge",
+                   " keys, 10M contains, half of them hits, >2^32 slots:",
+                   static_cast<int64_t>(num_keys), 1, repetition, {contains});
+}
+
+// every page and placement setting, against plain operator new
+template <class Table>
+void bench_memory_policies(const string& name, uint64_t num_keys,
+                           double max_load, int repetition) {
+    const vector<std::pair<string, MemoryPolicy>> policies = {
+        {"", {}},
+        {" THP", {PageMode::Transparent}},
+        {" hugetlbfs", {PageMode::HugeTlb}},
+        {" interleave", {PageMode::Default, NumaMode::Interleave}},
+        {" THP interleave", {PageMode::Transparent, NumaMode::Interleave}},
+        {" THP node 0", {PageMode::Transparent, NumaMode::Bind, 0}}};
+    vector<TableTiming> inserts{};
+    vector<TableTiming> lookups{};
+    for (const auto& [policy_name, policy] : policies) {
+        auto [insert, contains] =
+            time_table<Table>(name + policy_name, num_keys, max_load, policy);
+        inserts.push_back(insert);
+        lookups.push_back(contains);
+    }
+    report_results("insert_memory_policy", " keys inserted after reserve:",
+                   static_cast<int64_t>(num_keys), 1, repetition, inserts);
+    report_results("contains_memory_policy",
+                   " keys, 10M contains, half of them hits:",
+                   static_cast<int64_t>(num_keys), 1, repetition, lookups);
+}
+
+}  // namespace
+
+void bench_large_table() {
+    using Bitmaps32 = HopscotchHashSet<uint32_t, 32, LinearGrowthPolicy>;
+    using Bitmaps64 =
+        HopscotchHashSet<uint32_t, 32, LinearGrowthPolicy, uint64_t>;
+    using Shadow32 = HopscotchShadow<uint32_t>;
+    using Shadow64 = HopscotchShadow<uint32_t, std::hash<uint32_t>,
+                                     PowerOfTwoGrowthPolicy, false, uint64_t>;
+    using DenseShadow32 =
+        HopscotchShadow<uint32_t, std::hash<uint32_t>, PowerOfTwoGrowthPolicy,
+                        false, uint32_t, DenseStorage>;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        // what 64-bit indices and hashes cost where 32 bits would do
+        bench_size_types<Bitmaps32, Bitmaps64>("Hopscotch bitmaps",
+                                               10'000'000, 0.8, repetition);
+        bench_size_types<Shadow32, Shadow64>("Hopscotch shadow", 10'000'000,
+                                             0.8, repetition);
+        // where lookups miss the dTLB, 2MB pages and node placement
+        bench_memory_policies<Bitmaps32>("Hopscotch bitmaps", 10'000'000, 0.8,
+                                         repetition);
+        bench_memory_policies<DenseShadow32>("Hopscotch shadow dense",
+                                             10'000'000, 0.8, repetition);
+        // 3.5G keys at 0.8 is 4.4G slots (2^33 for shadow), more than 2^32
+        // keys would not fit uint32_t; needs ~40GB (bitmaps), ~20GB (shadow)
+        const uint64_t num_keys = 3'500'000'000;
+        bench_huge<Bitmaps64>("Hopscotch bitmaps 64-bit", num_keys, 0.8, 8.5,
+                              repetition);
+        bench_huge<Shadow64>("Hopscotch shadow 64-bit", num_keys, 0.8, 4.0,
+                             repetition);
+    }
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "lookup_pipeline.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// unique non-negative keys in random order, first half goes into the table
+// multiplying by an odd number is a bijection mod 2^31
+vector<int> make_keys(int num_keys, std::mt19937& rng) {
+    vector<int> res(2 * static_cast<size_t>(num_keys));
+    std::iota(res.begin(), res.end(), 0);
+    for (int& v : res) {
+        v = static_cast<int>((static_cast<uint32_t>(v) * 0x9E3779B1u) &
+                             0x7FFFFFFFu);
+    }
+    std::ranges::shuffle(res, rng);
+    return res;
+}
+
+template <class Table>
+TableTiming time_plain(const string& name, const Table& table,
+                       const vector<int>& lookups) {
+    int counter = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int v : lookups) {
+        counter += table.contains(v);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, static_cast<double>(table.load_factor()),
+            counter};
+}
+
+template <size_t Width, class Table>
+TableTiming time_pipeline(const string& name, const Table& table,
+                          const vector<int>& lookups) {
+    int counter = 0;
+    auto begin = std::chrono::steady_clock::now();
+    LookupPipeline<Table, Width>(table).run(
+        lookups.begin(), lookups.end(),
+        [&counter](size_t, bool found) { counter += found; });
+    auto end = std::chrono::steady_clock::now();
+    return {name + " pipeline " + std::to_string(Width), end - begin,
+            static_cast<double>(table.load_factor()), counter};
+}
+
+template <class Table>
+vector<TableTiming> time_table(const string& name, const Table& table,
+                               const vector<int>& lookups) {
+    return {time_plain(name, table, lookups),
+            time_pipeline<4>(name, table, lookups),
+            time_pipeline<8>(name, table, lookups),
+            time_pipeline<16>(name, table, lookups),
+            time_pipeline<32>(name, table, lookups)};
+}
+
+// tables are built one at a time, 100M keys don't leave room for both
+template <class Table>
+void bench_table(const string& name, const vector<int>& keys,
+                 const vector<int>& lookups, int size, int repetition) {
+    Table table{};
+    prepare_table(table);
+    if constexpr (requires { table.max_load_factor(0.8); }) {
+        table.max_load_factor(0.8);
+    }
+    table.reserve(static_cast<uint32_t>(size));
+    for (int i = 0; i < size; ++i) {
+        insert_key(table, keys[i]);
+    }
+    report_results("contains_half_true",
+                   " contains, half true, in random order:", size, 1,
+                   repetition, time_table(name, table, lookups));
+}
+
+}  // namespace
+
+void bench_lookup_pipeline() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int size : {10'000'000, 100'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 600, repetition);
+            vector<int> keys = make_keys(size, rng);
+            // as many lookups as keys, half of them were inserted
+            vector<int> lookups(keys.begin() + size / 2,
+                                keys.begin() + size + size / 2);
+            std::ranges::shuffle(lookups, rng);
+            bench_table<HopscotchShadow<int>>("Hopscotch shadow", keys,
+                                              lookups, size, repetition);
+            bench_table<HopscotchHashSet<int>>("Hopscotch bitmaps", keys,
+                                               lookups, size, repetition);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "mapped_storage.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+using HeapSet = HopscotchHashSet<uint32_t>;
+using MappedSet =
+    HopscotchHashSet<uint32_t, 32, LinearGrowthPolicy, uint32_t, MappedStorage>;
+
+// murmur3 finalizer, distinct indices give distinct keys
+uint32_t key_of(uint64_t i) {
+    uint32_t h = static_cast<uint32_t>(i + 1);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+const uint64_t kNumLookups = 10'000'000;
+const double kMaxLoad = 0.8;
+// a slot and its bit in occupied
+const double kBytesPerSlot = sizeof(uint32_t) * 2 + 1.0 / 8;
+
+uint64_t physical_memory() {
+    return static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) *
+           static_cast<uint64_t>(sysconf(_SC_PAGE_SIZE));
+}
+
+std::filesystem::path data_dir() {
+    const string& dir = bench_config().data_dir;
+    return dir.empty() ? std::filesystem::temp_directory_path()
+                       : std::filesystem::path(dir);
+}
+
+uint64_t free_disk(const std::filesystem::path& dir) {
+    struct statvfs st;
+    if (statvfs(dir.c_str(), &st) != 0) return 0;
+    return static_cast<uint64_t>(st.f_bavail) * st.f_frsize;
+}
+
+// {insert of num_keys keys after reserve, kNumLookups contains, half hits}
+template <class Table>
+std::pair<TableTiming, TableTiming> time_table(Table& table,
+                                               const string& name,
+                                               uint64_t num_keys) {
+    table.max_load_factor(kMaxLoad);
+    table.reserve(static_cast<uint32_t>(num_keys));
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < num_keys; ++i) {
+        table.add(key_of(i));
+    }
+    auto end = std::chrono::steady_clock::now();
+    TableTiming insert{name, end - begin, table.load_factor()};
+
+    std::mt19937_64 rng(bench_config().seed);
+    std::uniform_int_distribution<uint64_t> pick(0, 2 * num_keys - 1);
+    int counter = 0;
+    begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < kNumLookups; ++i) {
+        counter += table.contains(key_of(pick(rng)));
+    }
+    end = std::chrono::steady_clock::now();
+    return {insert, {name, end - begin, table.load_factor(), counter}};
+}
+
+void bench_size(uint64_t num_keys, const string& label, int repetition) {
+    uint64_t needed =
+        static_cast<uint64_t>(num_keys / kMaxLoad * kBytesPerSlot);
+    std::filesystem::path dir = data_dir();
+    // a rebuild holds the old and the new table
+    if (needed * 3 > free_disk(dir)) {
+        std::cerr << "Hopscotch bitmaps mapped " << label
+                  << ": skipped, needs about " << (needed * 3 >> 30)
+                  << "GB free in " << dir << std::endl;
+        return;
+    }
+    vector<TableTiming> inserts{};
+    vector<TableTiming> lookups{};
+    if (needed < physical_memory() / 10 * 9) {
+        HeapSet table{};
+        auto [insert, contains] = time_table(table, "Hopscotch bitmaps",
+                                             num_keys);
+        inserts.push_back(insert);
+        lookups.push_back(contains);
+    }
+    std::filesystem::path path =
+        dir / ("hopscotch_bench_" + std::to_string(getpid()) + ".set");
+    std::filesystem::remove(path);
+    {
+        MappedSet table{};
+        table.open(path.string());
+        auto [insert, contains] =
+            time_table(table, "Hopscotch bitmaps mapped", num_keys);
+        inserts.push_back(insert);
+        lookups.push_back(contains);
+    }
+    std::filesystem::remove(path);
+    report_results("insert_mapped",
+                   " keys inserted after reserve, " + label + ":",
+                   static_cast<int64_t>(num_keys), 1, repetition, inserts);
+    report_results("contains_mapped",
+                   " keys, 10M contains, half of them hits, " + label + ":",
+                   static_cast<int64_t>(num_keys), 1, repetition, lookups);
+}
+
+}  // namespace
+
+void bench_mapped() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        bench_size(10'000'000, "below RAM", repetition);
+        // the in-memory table doesn't fit, the mapped one pages to disk
+        uint64_t above = static_cast<uint64_t>(
+            physical_memory() * 1.25 / kBytesPerSlot * kMaxLoad);
+        // uint32_t keys and size_type
+        if (above < (uint64_t{1} << 31)) {
+            bench_size(above, "above RAM", repetition);
+        }
+    }
+}
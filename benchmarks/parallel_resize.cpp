@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+using Shadow = HopscotchShadow<int>;
+
+// random non-negative keys, a few repeat
+Shadow make_table(int size, std::mt19937& rng) {
+    Shadow table{};
+    prepare_table(table);
+    table.max_load_factor(0.8f);
+    table.reserve(size);
+    std::uniform_int_distribution<int> dist(0, (1 << 30) - 1);
+    for (int i = 0; i < size; ++i) {
+        table.insert(dist(rng));
+    }
+    return table;
+}
+
+// 1, 2, 4, ... threads, and all of them
+vector<unsigned> thread_counts() {
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    vector<unsigned> res{};
+    for (unsigned n = 1; n < max_threads; n *= 2) {
+        res.push_back(n);
+    }
+    res.push_back(max_threads);
+    if (max_threads < 4) {
+        // still shows the cost of splitting on a small box
+        res.push_back(4);
+    }
+    return res;
+}
+
+// counter is the number of keys after the rebuild
+TableTiming time_doubling(const Shadow& filled, unsigned num_threads) {
+    Shadow table = filled;
+    table.set_resize_threads(num_threads);
+    auto begin = std::chrono::steady_clock::now();
+    table.rehash(2 * table.get_max_size());
+    auto end = std::chrono::steady_clock::now();
+    return {"Hopscotch shadow " + std::to_string(num_threads) + " threads",
+            end - begin, table.load_factor(),
+            static_cast<int>(table.get_size())};
+}
+
+}  // namespace
+
+void bench_parallel_resize() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int size : {1'000'000, 10'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 900, repetition);
+            Shadow filled = make_table(size, rng);
+            vector<TableTiming> timings{};
+            for (unsigned num_threads : thread_counts()) {
+                timings.push_back(time_doubling(filled, num_threads));
+            }
+            report_results("parallel_resize",
+                           " keys, rebuild into a table twice the size:", size,
+                           1, repetition, timings);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// unique non-negative keys in random order
+// multiplying by an odd number is a bijection mod 2^31
+vector<int> make_keys(int num_keys, std::mt19937& rng) {
+    vector<int> res(num_keys);
+    std::iota(res.begin(), res.end(), 0);
+    for (int& v : res) {
+        v = static_cast<int>((static_cast<uint32_t>(v) * 0x9E3779B1u) &
+                             0x7FFFFFFFu);
+    }
+    std::ranges::shuffle(res, rng);
+    return res;
+}
+
+template <class Table>
+TableTiming time_fill(const string& name, const vector<int>& keys,
+                      bool is_reserved) {
+    Table table{};
+    prepare_table(table);
+    auto begin = std::chrono::steady_clock::now();
+    if (is_reserved) {
+        table.reserve(static_cast<uint32_t>(keys.size()));
+    }
+    for (int v : keys) {
+        insert_key(table, v);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, end - begin, static_cast<double>(table.load_factor())};
+}
+
+vector<TableTiming> time_all_tables(const vector<int>& keys,
+                                    bool is_reserved) {
+    return {
+        time_fill<std::unordered_set<int>>("Unordered_set", keys, is_reserved),
+        time_fill<HopscotchShadow<int>>("Hopscotch shadow", keys, is_reserved),
+        time_fill<HopscotchShadow<int, std::hash<int>, OneAndHalfGrowthPolicy>>(
+            "Hopscotch shadow 1.5x", keys, is_reserved),
+        time_fill<HopscotchShadow<int, std::hash<int>, PrimeGrowthPolicy>>(
+            "Hopscotch shadow prime", keys, is_reserved),
+        time_fill<HopscotchHashSet<int>>("Hopscotch bitmaps", keys,
+                                         is_reserved),
+        time_fill<HopscotchHashSet<int, 32, PowerOfTwoGrowthPolicy>>(
+            "Hopscotch bitmaps pow2", keys, is_reserved)};
+}
+
+}  // namespace
+
+void bench_reserve() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int size : {1'000'000, 10'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 300, repetition);
+            vector<int> keys = make_keys(size, rng);
+            report_results("insert_no_reserve", " inserts into a default table:",
+                           size, 1, repetition, time_all_tables(keys, false));
+            report_results("insert_reserve", " inserts after reserve(size):",
+                           size, 1, repetition, time_all_tables(keys, true));
+        }
+    }
+}
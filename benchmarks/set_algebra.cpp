@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "set_algebra.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// unique non-negative keys in random order
+// multiplying by an odd number is a bijection mod 2^31
+vector<int> make_keys(int num_keys, std::mt19937& rng) {
+    vector<int> res(num_keys);
+    std::iota(res.begin(), res.end(), 0);
+    for (int& v : res) {
+        v = static_cast<int>((static_cast<uint32_t>(v) * 0x9E3779B1u) &
+                             0x7FFFFFFFu);
+    }
+    std::ranges::shuffle(res, rng);
+    return res;
+}
+
+template <class Table>
+Table make_table(Table table, const vector<int>& keys, uint32_t reserve_for) {
+    prepare_table(table);
+    table.reserve(reserve_for);
+    for (int v : keys) {
+        insert_key(table, v);
+    }
+    return table;
+}
+
+// what callers did before: walk a, ask b key by key
+template <class Table>
+vector<int> naive_select(const Table& a, const Table& b, bool keep_found) {
+    vector<int> keys{};
+    a.for_each_key(0, a.bucket_count(), [&](int key) {
+        if (contains_key(b, key) == keep_found) keys.push_back(key);
+    });
+    return keys;
+}
+
+template <class Table>
+Table naive_intersect(const Table& a, const Table& b) {
+    vector<int> keys = naive_select(a, b, true);
+    Table res = a.empty_copy();
+    res.reserve(static_cast<uint32_t>(keys.size()));
+    for (int v : keys) {
+        insert_key(res, v);
+    }
+    return res;
+}
+
+// counter is the number of keys in the result
+template <class Op>
+TableTiming time_op(const string& name, double load_factor, Op&& op) {
+    auto begin = std::chrono::steady_clock::now();
+    auto res = op();
+    auto end = std::chrono::steady_clock::now();
+    int counter;
+    if constexpr (requires { res.size(); }) {
+        counter = static_cast<int>(res.size());
+    } else {
+        counter = static_cast<int>(set_algebra_detail::num_keys(res));
+    }
+    return {name, end - begin, load_factor, counter};
+}
+
+template <class Table>
+void bench_pair(const string& name, const Table& a, const Table& b,
+                int size, int repetition) {
+    // a table that had to grow on its own got a new seed, check the result
+    string layout = a.is_aligned_with(b) ? "aligned" : "not_aligned";
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+    string threads_name =
+        name + " bulk " + std::to_string(num_threads) + " threads";
+    double load = b.load_factor();
+    // probes alone, filling the result costs the same for every variant
+    for (bool keep_found : {true, false}) {
+        string op = keep_found ? "intersect" : "difference";
+        report_results(
+            op + "_probe_" + layout,
+            " keys in each table, " + op + " probes only, " + layout + ":",
+            size, 1, repetition,
+            {time_op(name + " naive", load,
+                     [&] { return naive_select(a, b, keep_found); }),
+             time_op(name + " bulk", load,
+                     [&] {
+                         return set_algebra_detail::select_keys(
+                             a, b, keep_found, 1);
+                     }),
+             time_op(threads_name, load, [&] {
+                 return set_algebra_detail::select_keys(a, b, keep_found,
+                                                        num_threads);
+             })});
+    }
+    report_results(
+        "intersect_" + layout,
+        " keys in each table, intersect into a new table, " + layout + ":",
+        size, 1, repetition,
+        {time_op(name + " naive", load, [&] { return naive_intersect(a, b); }),
+         time_op(name + " bulk", load, [&] { return intersect(a, b); }),
+         time_op(threads_name, load,
+                 [&] { return intersect(a, b, num_threads); })});
+}
+
+}  // namespace
+
+void bench_set_algebra() {
+    const int size = 10'000'000;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        std::mt19937 rng = make_bench_rng(size, 800, repetition);
+        // a and b share half of their keys
+        vector<int> all_keys = make_keys(size + size / 2, rng);
+        vector<int> keys_a(all_keys.begin(), all_keys.begin() + size);
+        vector<int> keys_b(all_keys.begin() + size / 2, all_keys.end());
+
+        {
+            auto a = make_table(HopscotchShadow<int>{}, keys_a, size);
+            bench_pair("Hopscotch shadow", a,
+                       make_table(HopscotchShadow<int>{}, keys_b, size), size,
+                       repetition);
+            bench_pair("Hopscotch shadow", a,
+                       make_table(HopscotchShadow<int>{}, keys_b, 2 * size),
+                       size, repetition);
+        }
+        {
+            // same seed and size make the layouts equal, at load 0.5 neither
+            // table has to grow and pick a new seed
+            auto a = make_table(HopscotchHashSet<int>(128, 5, default_seed),
+                                keys_a, 2 * size);
+            bench_pair("Hopscotch bitmaps", a,
+                       make_table(HopscotchHashSet<int>(128, 5, default_seed),
+                                  keys_b, 2 * size),
+                       size, repetition);
+            bench_pair("Hopscotch bitmaps", a,
+                       make_table(HopscotchHashSet<int>(128, 5, 12345),
+                                  keys_b, 2 * size),
+                       size, repetition);
+        }
+    }
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "snapshot_shadow.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+using Shadow = HopscotchShadow<int>;
+using Clock = std::chrono::steady_clock;
+
+// writes between two publishes (or two unique locks)
+const int kWriteBatch = 1000;
+// a stall is timed over this many lookups, so the clock isn't read per key
+const int kStallBatch = 256;
+
+// HopscotchShadow behind a reader-writer lock, what SnapshotShadow replaces
+class LockedShadow {
+   public:
+    explicit LockedShadow(const Shadow& init) : table(init) {}
+
+    void insert_batch(const vector<int>& keys, size_t first, size_t last) {
+        std::unique_lock lock(mutex);
+        for (size_t i = first; i < last; ++i) {
+            table.insert(keys[i]);
+        }
+    }
+    bool contains(int key) const {
+        std::shared_lock lock(mutex);
+        return table.probe_hashed(key, table.hash_key(key));
+    }
+
+   private:
+    Shadow table;
+    mutable std::shared_mutex mutex{};
+};
+
+struct ReadTimings {
+    TableTiming reads;  // per 1M lookups
+    TableTiming stall;  // slowest kStallBatch lookups
+};
+
+// num_readers threads look up published keys while the writer inserts
+// num_keys keys into an empty table, growing it all the way
+// make_read(thread) returns the lookup of that thread
+template <class Write, class MakeRead>
+ReadTimings time_reads(const string& name, const vector<int>& keys,
+                       unsigned num_readers, Write&& write_batch,
+                       MakeRead&& make_read) {
+    std::atomic<size_t> num_published{0};
+    std::atomic<bool> is_done{false};
+    std::atomic<uint64_t> num_reads{0};
+    std::atomic<uint64_t> num_hits{0};
+    std::atomic<int64_t> longest_stall_ns{0};
+    auto read_keys = [&](unsigned thread) {
+        auto contains = make_read(thread);
+        std::mt19937 rng(static_cast<unsigned>(bench_config().seed) + thread);
+        uint64_t reads = 0;
+        uint64_t hits = 0;
+        int64_t longest = 0;
+        while (!is_done.load(std::memory_order_relaxed)) {
+            size_t upto = num_published.load(std::memory_order_acquire);
+            if (upto == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::uniform_int_distribution<size_t> pick(0, upto - 1);
+            auto begin = Clock::now();
+            for (int i = 0; i < kStallBatch; ++i) {
+                hits += contains(keys[pick(rng)]);
+            }
+            longest = std::max<int64_t>(
+                longest, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::now() - begin)
+                             .count());
+            reads += kStallBatch;
+        }
+        num_reads += reads;
+        num_hits += hits;
+        int64_t seen = longest_stall_ns.load();
+        while (longest > seen &&
+               !longest_stall_ns.compare_exchange_weak(seen, longest)) {
+        }
+    };
+
+    vector<std::thread> readers{};
+    for (unsigned thread = 0; thread < num_readers; ++thread) {
+        readers.emplace_back(read_keys, thread);
+    }
+    auto begin = Clock::now();
+    for (size_t first = 0; first < keys.size(); first += kWriteBatch) {
+        size_t last = std::min(keys.size(), first + kWriteBatch);
+        write_batch(first, last);
+        num_published.store(last, std::memory_order_release);
+    }
+    auto end = Clock::now();
+    is_done = true;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+
+    double reads = static_cast<double>(std::max<uint64_t>(num_reads, 1));
+    std::chrono::duration<double, std::milli> window = end - begin;
+    std::chrono::duration<double, std::milli> longest =
+        std::chrono::nanoseconds(longest_stall_ns.load());
+    // hits in thousands, every read is of a published key
+    int hits = static_cast<int>(num_hits / 1000);
+    return {{name, window * num_readers * (1'000'000 / reads), 0.0, hits},
+            {name, longest, 0.0}};
+}
+
+}  // namespace
+
+void bench_snapshot_readers() {
+    // at least 2, clamped before the - 1 since 0 means "unknown"
+    unsigned num_readers =
+        std::max(3u, std::thread::hardware_concurrency()) - 1;
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int size : {1'000'000, 4'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 1000, repetition);
+            std::uniform_int_distribution<int> dist(0, (1 << 30) - 1);
+            vector<int> keys(size);
+            for (int& key : keys) {
+                key = dist(rng);
+            }
+            Shadow init{};
+            prepare_table(init);
+
+            LockedShadow locked(init);
+            ReadTimings locked_timings = time_reads(
+                "Hopscotch shadow shared_mutex", keys, num_readers,
+                [&](size_t first, size_t last) {
+                    locked.insert_batch(keys, first, last);
+                },
+                [&](unsigned) {
+                    return [&](int key) { return locked.contains(key); };
+                });
+
+            SnapshotShadow<Shadow> snapshots(init);
+            ReadTimings snapshot_timings = time_reads(
+                "Hopscotch shadow snapshots", keys, num_readers,
+                [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) {
+                        snapshots.insert(keys[i]);
+                    }
+                    snapshots.publish();
+                },
+                [&](unsigned) {
+                    return [reader = snapshots.make_reader()](
+                               int key) mutable {
+                        return reader.contains(key);
+                    };
+                });
+
+            string header = " keys inserted into an empty table, " +
+                            std::to_string(num_readers) + " readers";
+            report_results("reads_during_growth",
+                           header + ", reader time per 1M lookups (hits/1000):",
+                           size, 1, repetition,
+                           {locked_timings.reads, snapshot_timings.reads});
+            report_results("read_stall_during_growth",
+                           header + ", slowest 256 lookups of a reader:", size,
+                           1, repetition,
+                           {locked_timings.stall, snapshot_timings.stall});
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+#include "benches.h"
+#include "key_sets.h"
+#include "table_adapters.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+template <class Storage>
+using Shadow = HopscotchShadow<int, std::hash<int>, PowerOfTwoGrowthPolicy,
+                               false, uint32_t, Storage>;
+
+// bytes malloc has handed out and not taken back, mapped chunks included
+size_t heap_in_use() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+struct StorageTimings {
+    TableTiming insert;
+    TableTiming contains_hits;
+    TableTiming contains_misses;
+    TableTiming memory;
+};
+
+template <class Storage>
+StorageTimings time_storage(const string& name, std::span<const int> hits,
+                            std::span<const int> misses) {
+    size_t heap_before = heap_in_use();
+    auto table = std::make_unique<Shadow<Storage>>();
+    table->set_deleted_key(-1);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int key : hits) {
+        table->insert(key);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double load_factor = table->load_factor();
+    TableTiming insert{name, end - begin, load_factor,
+                       static_cast<int>(table->get_size())};
+
+    int num_found = 0;
+    begin = std::chrono::steady_clock::now();
+    for (int key : hits) {
+        num_found += table->contains(key);
+    }
+    end = std::chrono::steady_clock::now();
+    TableTiming contains_hits{name, end - begin, load_factor, num_found};
+
+    num_found = 0;
+    begin = std::chrono::steady_clock::now();
+    for (int key : misses) {
+        num_found += table->contains(key);
+    }
+    end = std::chrono::steady_clock::now();
+    TableTiming contains_misses{name, end - begin, load_factor, num_found};
+
+    // time is meaningless here, the counter is the point
+    size_t heap_after = heap_in_use();
+    TableTiming memory{name, std::chrono::duration<double>(0), load_factor,
+                       static_cast<int>((heap_after - heap_before) >> 10)};
+    return {insert, contains_hits, contains_misses, memory};
+}
+
+}  // namespace
+
+void bench_sparse_groups() {
+    for (int repetition = 0; repetition < bench_config().repetitions;
+         ++repetition) {
+        for (int size : {1'000'000, 10'000'000}) {
+            std::mt19937 rng = make_bench_rng(size, 1400, repetition);
+            KeySet keys(size, size, rng);
+            vector<StorageTimings> timings = {
+                time_storage<SparseStorage>("Hopscotch shadow sparsetable",
+                                            keys.hits(), keys.misses()),
+                time_storage<SparseGroupStorage>(
+                    "Hopscotch shadow sparse groups", keys.hits(),
+                    keys.misses()),
+                time_storage<DenseStorage>("Hopscotch shadow dense",
+                                           keys.hits(), keys.misses())};
+            auto column = [&](TableTiming StorageTimings::*field) {
+                vector<TableTiming> res{};
+                for (const StorageTimings& timing : timings) {
+                    res.push_back(timing.*field);
+                }
+                return res;
+            };
+            report_results("insert_storage", " keys inserted:", size, 1,
+                           repetition, column(&StorageTimings::insert));
+            report_results("contains_hits_storage", " keys looked up (hits):",
+                           size, 1, repetition,
+                           column(&StorageTimings::contains_hits));
+            report_results("contains_misses_storage",
+                           " keys looked up (misses):", size, 1, repetition,
+                           column(&StorageTimings::contains_misses));
+            report_results("memory_storage",
+                           " keys stored (counter = KB of heap in use):", size,
+                           1, repetition, column(&StorageTimings::memory));
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// uniform insert/contains over every table we bench, so generic benches can be templates
+// calls are picked by what the table has, so new table parameters need no new overloads
+
+#include <sparsehash/dense_hash_set>
+#include <sparsehash/sparse_hash_set>
+#include <unordered_set>
+
+#include "hopscotch_bitmaps.h"
+#include "hopscotch_shadow.h"
+
+// keys that benches never generate, specialize for non-integer keys
+template <class Key>
+struct BenchSentinels {
+    static Key empty_key() { return -1; }
+    static Key deleted_key() { return -2; }
+};
+
+// sparsehash tables and HopscotchShadow need sentinels before the first insert
+template <class Table>
+void prepare_table(Table& table) {
+    using Key = typename Table::key_type;
+    if constexpr (requires { table.set_deleted_key(Key{}); }) {
+        table.set_deleted_key(BenchSentinels<Key>::deleted_key());
+    }
+    if constexpr (requires { table.set_empty_key(Key{}); }) {
+        table.set_empty_key(BenchSentinels<Key>::empty_key());
+    }
+}
+
+template <class Table, class Key>
+void insert_key(Table& table, const Key& key) {
+    if constexpr (requires { table.add(key); }) {
+        table.add(key);
+    } else {
+        table.insert(key);
+    }
+}
+
+template <class Table, class Key>
+bool contains_key(const Table& table, const Key& key) {
+    if constexpr (requires { table.contains(key); }) {
+        return table.contains(key);
+    } else {
+        return table.find(key) != table.end();
+    }
+}
+
+template <class Table, class Key>
+void erase_key(Table& table, const Key& key) {
+    if constexpr (requires { table.remove(key); }) {
+        table.remove(key);
+    } else {
+        table.erase(key);
+    }
+}
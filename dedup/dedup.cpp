@@ -0,0 +1,160 @@
+#include <sys/resource.h>
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "dedup.h"
+#include "hopscotch_bitmaps.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+struct Options {
+    int width = 8;  // bytes per key
+    string table = "shadow";
+    string output_path{};  // empty -> only count
+    uint64_t reserve = 0;  // expected unique keys
+    vector<string> inputs{};
+};
+
+void print_usage() {
+    std::cerr
+        << "Usage:\n"
+        << "  dedup [--width 4|8] [--table shadow|bitmaps] [--reserve N]\n"
+        << "        [--output FILE] INPUT...\n"
+        << "Inputs are raw native-endian integers of width bytes. Unique keys\n"
+        << "go to FILE in the same format, in the order they first appear;\n"
+        << "without --output only their number is printed.\n";
+}
+
+// the whole of text as a non-negative number, no sign or trailing junk
+template <class Number>
+bool parse_number(const string& text, Number& res) {
+    if (text.empty() || text[0] == '-') return false;
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, res);
+    return ec == std::errc() && ptr == end;
+}
+
+// peak resident set of this process, Linux reports it in KB
+uint64_t peak_memory_bytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+template <class Table>
+void run(const Options& options, Table& table) {
+    if (options.reserve > 0) {
+        table.reserve(static_cast<typename Table::size_type>(options.reserve));
+    }
+    std::ofstream output{};
+    if (!options.output_path.empty()) {
+        output.open(options.output_path, std::ios::binary);
+        if (!output) {
+            throw std::runtime_error("can't write " + options.output_path);
+        }
+    }
+    bool is_writing = output.is_open();
+    auto begin = std::chrono::steady_clock::now();
+    DedupStats stats = dedup_files(
+        table, options.inputs, [&](const typename Table::key_type& key) {
+            if (is_writing) {
+                output.write(reinterpret_cast<const char*>(&key), sizeof(key));
+            }
+        });
+    if (is_writing) {
+        output.close();
+        if (!output) {
+            throw std::runtime_error("can't write " + options.output_path);
+        }
+    }
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - begin;
+
+    std::cout << stats.num_unique << std::endl;
+    std::cerr << stats.num_keys << " keys, " << stats.num_unique
+              << " unique, "
+              << static_cast<double>(stats.num_bytes) / (1 << 20) /
+                     seconds.count()
+              << " MB/s, peak memory "
+              << static_cast<double>(peak_memory_bytes()) / (1 << 20)
+              << " MB" << std::endl;
+}
+
+// see DedupShadow in dedup.h
+template <class Key>
+void run_shadow(const Options& options) {
+    DedupShadow<Key> table{};
+    table.set_erase_mode(EraseMode::BackwardShift);
+    run(options, table);
+}
+
+template <class Key>
+void run_bitmaps(const Options& options) {
+    HopscotchHashSet<Key, 32, LinearGrowthPolicy, uint64_t> table{};
+    run(options, table);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options{};
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--width" && has_value) {
+            if (!parse_number(argv[++i], options.width)) {
+                print_usage();
+                return 2;
+            }
+        } else if (arg == "--table" && has_value) {
+            options.table = argv[++i];
+        } else if (arg == "--output" && has_value) {
+            options.output_path = argv[++i];
+        } else if (arg == "--reserve" && has_value) {
+            if (!parse_number(argv[++i], options.reserve)) {
+                print_usage();
+                return 2;
+            }
+        } else if (!arg.starts_with("--")) {
+            options.inputs.push_back(arg);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    if (options.inputs.empty() || (options.width != 4 && options.width != 8) ||
+        (options.table != "shadow" && options.table != "bitmaps")) {
+        print_usage();
+        return 2;
+    }
+
+    try {
+        if (options.table == "shadow") {
+            if (options.width == 4) {
+                run_shadow<uint32_t>(options);
+            } else {
+                run_shadow<uint64_t>(options);
+            }
+        } else {
+            if (options.width == 4) {
+                run_bitmaps<uint32_t>(options);
+            } else {
+                run_bitmaps<uint64_t>(options);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "dedup: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hopscotch_shadow.h"
+
+// Dedup of fixed-width keys (raw native-endian integers, back to back) read
+// from files, for the dedup tool and bench --dedup.
+// Inputs are mapped read-only with MADV_SEQUENTIAL, so the kernel reads ahead,
+// and pages already read are dropped from the mapping as the stream moves on,
+// so the table is the only thing that stays in memory.
+// Keys go to the table in batches: a batch is hashed, then every key is
+// inserted while the lines of the keys after it are prefetched, like
+// set_algebra.h does for probes.
+
+// one input file, mapped for reading
+class MappedInput {
+   public:
+    // throws if path can't be opened or mapped
+    explicit MappedInput(const std::string& path);
+    ~MappedInput();
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+    // [0, end) is read, its pages are dropped, multiples of kDropStep only
+    void drop_before(size_t end);
+
+    // pages are dropped in steps this big
+    static constexpr size_t kDropStep = size_t{64} << 20;
+
+   private:
+    int fd = -1;
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+    size_t dropped = 0;
+};
+
+inline MappedInput::MappedInput(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open " + path + ": " +
+                                 std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("can't stat " + path + ": " +
+                                 std::strerror(err));
+    }
+    length = static_cast<size_t>(st.st_size);
+    // mmap refuses empty files, there is nothing to read anyway
+    if (length == 0) return;
+    void* addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("can't map " + path + ": " +
+                                 std::strerror(err));
+    }
+    madvise(addr, length, MADV_SEQUENTIAL);
+    bytes = static_cast<const unsigned char*>(addr);
+}
+
+inline MappedInput::~MappedInput() {
+    if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+    if (fd >= 0) ::close(fd);
+}
+
+inline void MappedInput::drop_before(size_t end) {
+    size_t step_end = end / kDropStep * kDropStep;
+    if (step_end <= dropped) return;
+    // clean file pages, they are read back from the file if touched again
+    madvise(const_cast<unsigned char*>(bytes) + dropped, step_end - dropped,
+            MADV_DONTNEED);
+    dropped = step_end;
+}
+
+// the table of dedup --table shadow
+// 64-bit sizes, inputs can have more than 2^31 unique keys
+// FibonacciMixing: std::hash of an integer is the integer, and ID files are
+// often strided or clustered, which an unmixed table can't hold
+// BackwardShift (set by the caller): no erases here, and it leaves every key
+// value usable, tombstones would take 0
+template <class Key>
+using DedupShadow = HopscotchShadow<Key, std::hash<Key>, PowerOfTwoGrowthPolicy,
+                                    false, uint64_t, SparseStorage,
+                                    FibonacciMixing>;
+
+struct DedupStats {
+    uint64_t num_keys = 0;
+    uint64_t num_unique = 0;
+    uint64_t num_bytes = 0;  // of input, trailing partial keys included
+};
+
+namespace dedup_detail {
+
+constexpr size_t kBatchSize = 1024;
+constexpr size_t kDistance = 16;
+
+// true if key wasn't in table; HopscotchHashSet::add keeps repeats, so it is
+// asked first
+template <class Table, class Key>
+bool insert_unique(Table& table, const Key& key) {
+    if constexpr (requires { table.add(key); }) {
+        if (table.contains(key)) return false;
+        table.add(key);
+        return true;
+    } else {
+        return table.insert(key).second;
+    }
+}
+
+}  // namespace dedup_detail
+
+// on_unique(key) for the first copy of every key, in input order
+// Key is uint32_t or uint64_t, bytes past the last whole key of a file are
+// skipped
+template <class Table, class F>
+DedupStats dedup_files(Table& table, const std::vector<std::string>& paths,
+                       F&& on_unique) {
+    using Key = typename Table::key_type;
+    using HashType = decltype(table.hash_key(std::declval<const Key&>()));
+    static_assert(Table::prefetch_stages >= 0 && Table::prefetch_stages <= 3,
+                  "dedup_files unrolls at most 3 prefetch stages");
+    using dedup_detail::kBatchSize;
+    using dedup_detail::kDistance;
+    DedupStats res{};
+    Key keys[kBatchSize];
+    HashType hashes[kBatchSize];
+    for (const std::string& path : paths) {
+        MappedInput input(path);
+        res.num_bytes += input.size();
+        size_t num_keys = input.size() / sizeof(Key);
+        for (size_t first = 0; first < num_keys; first += kBatchSize) {
+            size_t size = std::min(kBatchSize, num_keys - first);
+            // the mapping holds no Key objects, copy the bytes out
+            std::memcpy(keys, input.data() + first * sizeof(Key),
+                        size * sizeof(Key));
+            for (size_t i = 0; i < size; ++i) {
+                hashes[i] = table.hash_key(keys[i]);
+            }
+            for (size_t i = 0; i < size; ++i) {
+                // a resize in the batch only makes the later prefetches miss
+                constexpr int num_stages = Table::prefetch_stages;
+                if constexpr (num_stages > 2) {
+                    size_t ahead = i + (num_stages - 2) * kDistance;
+                    if (ahead < size) table.prefetch(hashes[ahead], 2);
+                }
+                if constexpr (num_stages > 1) {
+                    size_t ahead = i + (num_stages - 1) * kDistance;
+                    if (ahead < size) table.prefetch(hashes[ahead], 1);
+                }
+                if constexpr (num_stages > 0) {
+                    size_t ahead = i + num_stages * kDistance;
+                    if (ahead < size) table.prefetch(hashes[ahead], 0);
+                }
+                if (dedup_detail::insert_unique(table, keys[i])) {
+                    ++res.num_unique;
+                    on_unique(keys[i]);
+                }
+            }
+            input.drop_before((first + size) * sizeof(Key));
+        }
+        res.num_keys += num_keys;
+    }
+    return res;
+}
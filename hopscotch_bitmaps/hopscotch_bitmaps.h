@@ -1,18 +1,30 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <climits>
+#include <cmath>
+#include <exception>
 //#include <intrin.h>
 #include <iostream>
 #include <numeric>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "growth_policy.h"
+#include "hopscotch_stats.h"
+#include "memory_policy.h"
+#include "prefetch.h"
+
 //#pragma intrinsic(_BitScanForward)
 
 using std::cout;
@@ -27,29 +39,30 @@ using std::unordered_multiset;
 using std::unordered_set;
 using std::vector;
 
-// helper functions TODO add intrinsics?
-bool bit_check(uint32_t number, uint32_t n) {
-    return (number >> n) & (uint32_t)1;
+// helper functions, work on any width of bitmap
+template <std::unsigned_integral Bitmap>
+inline bool bit_check(Bitmap number, uint32_t n) {
+    return (number >> n) & (Bitmap)1;
 }
 
 // following functions change the number instead of returning it
-void bit_set_change(uint32_t& number, uint32_t n) {
-    number |= ((uint32_t)1 << n);
+template <std::unsigned_integral Bitmap>
+inline void bit_set_change(Bitmap& number, uint32_t n) {
+    number |= ((Bitmap)1 << n);
 }
 
-void bit_clear_change(uint32_t& number, uint32_t n) {
-    number &= ~((uint32_t)1 << n);
+template <std::unsigned_integral Bitmap>
+inline void bit_clear_change(Bitmap& number, uint32_t n) {
+    number &= ~((Bitmap)1 << n);
 }
 
-uint32_t minbit(uint32_t x) {
-    /*unsigned long res;
-    unsigned char isNonzero = _BitScanForward(&res, x);
-    return res * isNonzero;*/
-    int res = __builtin_ffs(x);
-    return res - (res ? 1 : 0);
+template <std::unsigned_integral Bitmap>
+inline uint32_t minbit(Bitmap x) {
+    // index of the lowest set bit, 0 for x == 0
+    return x ? std::countr_zero(x) : 0;
 }
 
-uint32_t math_mod(int x, int p) {
+inline uint32_t math_mod(int x, int p) {
     // Returns MATHEMATICALLY x % p (the number from 0 to p-1)
     // p must be positive
     assert(p > 0);
@@ -59,11 +72,12 @@ uint32_t math_mod(int x, int p) {
 const uint32_t Prime = 0x01000193;         //   16777619
 const uint32_t default_seed = 0x811C9DC5;  // 2166136261
 
-uint32_t fnv1a(unsigned char oneByte, uint32_t hash /*= Seed*/) {
+inline uint32_t fnv1a(unsigned char oneByte, uint32_t hash /*= Seed*/) {
     return (oneByte ^ hash) * Prime;
 }
 
-uint32_t fnv1a(const void* data, size_t numBytes, uint32_t hash /*= Seed*/) {
+inline uint32_t fnv1a(const void* data, size_t numBytes,
+                      uint32_t hash /*= Seed*/) {
     const unsigned char* ptr = (const unsigned char*)data;
     while (numBytes--) hash = fnv1a(*ptr++, hash);
     return hash;
@@ -91,41 +105,127 @@ uint32_t myhash(T key, uint32_t seed) {
     return fnv1a(&key, sizeof(key), seed);
 }
 
-uint32_t generate_seed() {  // TODO move to xorshift
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<uint32_t> distrib(
-        0, 4294967295);  // from 0 to max uint32_t
-    uint32_t newSeed = distrib(gen);
-    return newSeed;
+// 64-bit FNV-1a for tables of 64-bit size_type, a 32-bit hash can only pick
+// from 2^32 home buckets
+const uint64_t Prime64 = 0x00000100000001B3;
+const uint64_t Offset64 = 0xCBF29CE484222325;
+
+inline uint64_t fnv1a64(const void* data, size_t numBytes, uint64_t hash) {
+    const unsigned char* ptr = (const unsigned char*)data;
+    while (numBytes--) hash = (*ptr++ ^ hash) * Prime64;
+    return hash;
 }
 
-// https://en.wikipedia.org/wiki/Hopscotch_hashing
 template <typename T>
+uint64_t myhash64(T key, uint32_t seed) {
+    return fnv1a64(&key, sizeof(key), Offset64 ^ seed);
+}
+
+// seed for the attempt-th rebuild try of a table hashed with seed; splitmix64,
+// so the same keys and the same inserts always give the same layout
+inline uint32_t next_seed(uint32_t seed, uint32_t attempt) {
+    uint64_t z = ((static_cast<uint64_t>(seed) << 32) | attempt) +
+                 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+}
+
+// smallest unsigned integer that fits a neighborhood of HopRange slots
+template <uint32_t HopRange>
+using hop_bitmap_t = std::conditional_t<
+    (HopRange <= 8), uint8_t,
+    std::conditional_t<(HopRange <= 16), uint16_t,
+                       std::conditional_t<(HopRange <= 32), uint32_t,
+                                          uint64_t>>>;
+
+// https://en.wikipedia.org/wiki/Hopscotch_hashing
+// HopRange is the neighborhood size, it picks the bitmap type and lets
+// the compiler unroll neighborhood loops
+// GrowthPolicy picks table sizes on init/resize/rehash, see growth_policy.h
+// SizeType holds indices, sizes and the key count; uint32_t tables stop at 2^31
+// slots, uint64_t ones also hash to 64 bits, so every bucket can be a home
+template <typename T, uint32_t HopRange = 32,
+          class GrowthPolicy = LinearGrowthPolicy,
+          std::unsigned_integral SizeType = uint32_t,
+          class Storage = HeapStorage>
 class HopscotchHashSet {
+    static_assert(HopRange > 0 && HopRange <= 64,
+                  "HopRange must be in [1, 64]");
+
+   public:
+    using key_type = T;
+    using size_type = SizeType;
+    using growth_policy = GrowthPolicy;
+    using hash_type =
+        std::conditional_t<(sizeof(SizeType) > 4), uint64_t, uint32_t>;
+    using bitmap_type = hop_bitmap_t<HopRange>;
+    static constexpr uint32_t HOP_RANGE = HopRange;
+
+    using slot_allocator = PolicyAllocator<pair<T, bitmap_type>>;
+
    private:
     const T default_value{};
 
     // hopscotch parameters, initialized to defaults
-    uint32_t HOP_RANGE = 32;   // must be <= 32, default==32
     uint32_t ADD_RANGE = 128;  // should be >= HOP_RANGE, default==128
     uint32_t MAX_TRIES = 5;    // must be > 0, default==5
     uint32_t Seed = 0x811C9DC5;
 
-    uint32_t bad_bucket_ind =
-        0;  // index of bucket with ind==hash(default_value)
-    uint32_t bad_bucket_bitmap = 0;  // bitmap of that bucket
-    uint32_t num_elements = 0;       // number of elements
+    size_type num_elements = 0;  // number of elements
+    double max_load = 1.0;       // add grows the table before going above it
+    double min_load = 0.0;       // remove shrinks below it, 0 never shrinks
+    // table size and key count when a remove's shrink last failed, removes
+    // try again once the table was rebuilt or half of those keys are gone
+    uint64_t failed_shrink_size = 0;
+    size_type failed_shrink_elements = 0;
 
     // initially filled with key=default_key and bitmap=0
-    vector<pair<T, uint32_t>>
+    typename Storage::template array<pair<T, bitmap_type>>
         values;  // key + bitmap that contains info about ith bucket
+    // bit i is set if values[i].first holds a key, so default_value is an ordinary key
+    typename Storage::template array<uint64_t> occupied;
 
     bool is_resize_allowed =
         true;  // if false, table will just die instead of resizing -- for testing purposes
 
+    [[no_unique_address]] mutable HopscotchCounters<> counters{};
+
     void resize();       // double the size, rehash
     bool tryadd(T key);  // add element without resize
+    bool try_rebuild(uint64_t size,
+                     uint32_t seed);  // false if some key didn't fit
+    bool try_shrink(uint64_t size);  // false if the table stays as it is
+    void shrink_after_remove();  // try_shrink below min_load, unless it failed
+    // MappedStorage: true if values is the table the file opens to
+    bool is_published() const;
+    void publish();  // makes values the table the file opens to
+
+    size_type table_size() const {
+        return static_cast<size_type>(values.size());
+    }
+    hash_type hash_of(T key) const {
+        if constexpr (sizeof(hash_type) > 4) {
+            return myhash64(key, Seed);
+        } else {
+            return myhash(key, Seed);
+        }
+    }
+    bool is_occupied(size_type ind) const {
+        return (occupied[ind >> 6] >> (ind & 63)) & 1;
+    }
+    void set_occupied(size_type ind) {
+        occupied[ind >> 6] |= (uint64_t)1 << (ind & 63);
+    }
+    void clear_occupied(size_type ind) {
+        occupied[ind >> 6] &= ~((uint64_t)1 << (ind & 63));
+    }
+    // offset of the first free slot in [start, start + range) going around the end,
+    // range if there is none
+    uint32_t find_free_offset(size_type start, uint32_t range) const;
+    // slot of key, values.size() if it isn't there
+    // num_probes is filled only with HOPSCOTCH_STATS
+    size_type find_slot(T key, hash_type hash, uint32_t* num_probes) const;
 
    public:
     // create with default parameters
@@ -133,39 +233,117 @@ class HopscotchHashSet {
         // use defaults
     }
     // create with specific parameters TODO validate params
-    HopscotchHashSet(uint32_t init_HOP_RANGE, uint32_t init_ADD_RANGE,
-                     uint32_t init_MAX_TRIES, uint32_t init_Seed) {
-        HOP_RANGE = init_HOP_RANGE;
+    // HOP_RANGE is a template parameter
+    HopscotchHashSet(uint32_t init_ADD_RANGE, uint32_t init_MAX_TRIES,
+                     uint32_t init_Seed) {
         ADD_RANGE = init_ADD_RANGE;
         MAX_TRIES = init_MAX_TRIES;
         Seed = init_Seed;
     }
     void init(
-        uint32_t size = 1024,
+        size_type size = 1024,
         uint32_t seed = default_seed);  // init table of this size and this seed
     bool contains(T key) const;
+
+    // lookup in steps, for pipelines that overlap the cache misses of many keys
+    // (see lookup_pipeline.h): hash, prefetch every stage, then contains_hashed
+    // stage 0 -- home bucket with its bitmap, stage 1 -- the last slot the bitmap uses
+    static constexpr int prefetch_stages = 2;
+    hash_type hash_key(T key) const { return hash_of(key); }
+    void prefetch(hash_type hash, int stage) const;
+    bool contains_hashed(T key, hash_type hash) const;
+    // contains_hashed without stats, many threads can probe at once
+    bool probe_hashed(T key, hash_type hash) const {
+        return find_slot(key, hash, nullptr) != values.size();
+    }
+
+    // for bulk set operations (see set_algebra.h), ranges are of slots
+    size_type bucket_count() const { return table_size(); }
+    // same size and seed, so every key has the same home bucket in both
+    bool is_aligned_with(const HopscotchHashSet& other) const {
+        return values.size() == other.values.size() && Seed == other.Seed;
+    }
+    // f(key) for every key stored in slots [first, last)
+    template <class F>
+    void for_each_key(size_type first, size_type last, F&& f) const;
+    // f(key, other has it) for every key whose home bucket is in [first, last)
+    // compares neighborhoods of the same bucket, no hashing, needs is_aligned_with
+    template <class F>
+    void probe_aligned(const HopscotchHashSet& other, size_type first,
+                       size_type last, F&& f) const;
+    // no keys, same parameters and seed
+    HopscotchHashSet empty_copy() const;
+
     void add(T key);                // add with resize if needed
     void remove(T key);             // throws exception if no element found
+    // removes every key pred is true for, all copies of it, returns how
+    // many; walks the keys in slot order and clears their bits in the home
+    // bitmaps as it goes, no key is hashed. With num_threads > 1, pred is
+    // called from that many threads at once, each taking a range of slots
+    template <class Pred>
+    size_type erase_if(Pred pred, unsigned num_threads = 1);
     void print() const;             // prints table
     void allow_resize(bool allow);  // toggle is_resize_allowed
+    // pages and NUMA placement of values, moves the keys that are there
+    void set_memory_policy(const MemoryPolicy& policy);
+    MemoryPolicy memory_policy() const {
+        return values.get_allocator().memory_policy();
+    }
+    // MappedStorage only: the table in path, or a new empty one if path
+    // doesn't exist; rebuilds go into the same file (see mapped_storage.h)
+    void open(const string& path);
+    // MappedStorage only: writes the keys back, they are in the page cache
+    // before that
+    void sync();
+
+    void rehash(size_type n);  // rebuild with >= n slots, keeps max_load_factor
+    void reserve(size_type n);  // room for n keys, if neighborhoods allow
+    [[nodiscard]] double max_load_factor() const { return max_load; }
+    void max_load_factor(double ml) {
+        if (!(ml > 0.0 && ml <= 1.0))
+            throw std::runtime_error("Max load factor must be in (0, 1]");
+        max_load = ml;
+    }
+    [[nodiscard]] double min_load_factor() const { return min_load; }
+    void min_load_factor(double ml) {
+        if (!(ml >= 0.0 && ml < max_load))
+            throw std::runtime_error("Min load factor must be in [0, max)");
+        min_load = ml;
+    }
+    bool shrink_to_fit();  // false if no smaller table could be built
 
     [[nodiscard]] double load_factor()
         const;  // get load factor of a table, 0 <= load_factor <= 1
 
+    [[nodiscard]] HopscotchStats stats()
+        const;  // counters are zero without HOPSCOTCH_STATS
+    void reset_stats() { counters.reset(); }
+
     // for debugging purposes
     [[nodiscard]] vector<T> get_values() const;  // returns values as vector
-    [[nodiscard]] vector<uint32_t> get_bitmaps() const;  // returns bitmaps
-    [[nodiscard]] int get_num_elements() const;  // return number of elements
+    [[nodiscard]] vector<bitmap_type> get_bitmaps()
+        const;  // returns bitmaps
+    [[nodiscard]] size_type get_num_elements()
+        const;  // return number of elements
 };
 
-template <typename T>
-int HopscotchHashSet<T>::get_num_elements() const {
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+typename HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                          Storage>::size_type
+HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                 Storage>::get_num_elements() const {
     return num_elements;
 }
 
-template <typename T>
-vector<uint32_t> HopscotchHashSet<T>::get_bitmaps() const {
-    vector<uint32_t> res;
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+vector<
+    typename HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                              Storage>::bitmap_type>
+HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                 Storage>::get_bitmaps() const {
+    vector<bitmap_type> res;
     res.reserve(values.size());
     for (auto v : values) {
         res.push_back(v.second);
@@ -173,8 +351,10 @@ vector<uint32_t> HopscotchHashSet<T>::get_bitmaps() const {
     return res;
 }
 
-template <typename T>
-vector<T> HopscotchHashSet<T>::get_values() const {
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+vector<T> HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                           Storage>::get_values() const {
     vector<T> res;
     res.reserve(values.size());
     for (auto v : values) {
@@ -183,20 +363,45 @@ vector<T> HopscotchHashSet<T>::get_values() const {
     return res;
 }
 
-template <typename T>
-double HopscotchHashSet<T>::load_factor() const {
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+double HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                        Storage>::load_factor() const {
     if (values.empty()) return 0.0;  // for empty table I think it makes sense
     return static_cast<double>(num_elements) /
            static_cast<double>(values.size());
 }
 
-template <typename T>
-void HopscotchHashSet<T>::allow_resize(bool allow) {
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+HopscotchStats HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                                Storage>::stats() const {
+    HopscotchStats res;
+    counters.fill(res);
+    // no tombstones here, removed keys free their slot right away
+    for (const auto& v : values) {
+        bitmap_type bitmap = v.second;
+        histogram_add(res.neighborhood_occupancy, std::popcount(bitmap));
+        while (bitmap) {
+            uint32_t ind = minbit(bitmap);
+            histogram_add(res.home_distances, ind);
+            bit_clear_change(bitmap, ind);
+        }
+    }
+    return res;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::allow_resize(bool allow) {
     is_resize_allowed = allow;
 }
 
-template <typename T>
-void HopscotchHashSet<T>::print() const {
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::print() const {
     // T must be cout-able
     cout << "Table: ";
     for (const auto& v : values) {
@@ -204,61 +409,84 @@ void HopscotchHashSet<T>::print() const {
     }
     cout << "\nBitmaps: ";
     for (const auto& v : values) {
-        cout << v.second << " ";
+        cout << static_cast<uint64_t>(v.second) << " ";
+    }
+    cout << "\nOccupied: ";
+    for (size_type i = 0; i < values.size(); ++i) {
+        cout << is_occupied(i);
     }
     cout << endl;
-    cout << "Bad_bucket_ind: " << bad_bucket_ind << endl;
-    cout << "Bad_bucket_bitmap: " << bad_bucket_bitmap << endl;
     cout << "Elements: " << num_elements << endl;
     cout << "Size: " << values.size() << endl;
 }
 
-template <typename T>
-void HopscotchHashSet<T>::init(uint32_t size, uint32_t seed) {
-    vector<pair<T, uint32_t>> temp;
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::init(size_type size, uint32_t seed) {
+    size = growth_detail::to_size<size_type>(GrowthPolicy::round_up(size));
+    bool was_published = is_published();
+    // the old arrays are dropped after publish, a mapped file only frees
+    // regions the table it opens to doesn't use
+    decltype(values) temp(values.get_allocator());
     temp.resize(size, pair(default_value, 0));
     swap(values, temp);
+    decltype(occupied) temp_occupied(occupied.get_allocator());
+    temp_occupied.assign((static_cast<uint64_t>(size) + 63) / 64, 0);
+    swap(occupied, temp_occupied);
     Seed = seed;
-    bad_bucket_bitmap = 0;
-    bad_bucket_ind =
-        size
-            ? myhash(default_value, Seed) % size
-            : 0;  // init bad_bucket_ind with something if we init table of size 0 here
     num_elements = 0;
     is_resize_allowed = true;
+    if (was_published) publish();
 }
 
-template <typename T>
-void HopscotchHashSet<T>::resize() {
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+bool HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::try_rebuild(uint64_t size, uint32_t seed) {
+    HopscotchHashSet newSet(ADD_RANGE, MAX_TRIES, seed);
+    newSet.values = decltype(values)(values.get_allocator());
+    newSet.occupied = decltype(occupied)(occupied.get_allocator());
+    newSet.init(growth_detail::to_size<size_type>(size), seed);
+
+    bool flag = true;  // is rebuild successful
+    // walk set bits of occupied only
+    for (size_t word = 0; word < occupied.size() && flag; ++word) {
+        uint64_t bits = occupied[word];
+        while (bits) {
+            size_type i = word * 64 + std::countr_zero(bits);
+            bits &= bits - 1;
+            if (!newSet.tryadd(values[i].first)) {
+                flag = false;
+                break;
+            }
+        }
+    }
+    counters.record_resize_attempt(flag);
+    if (flag) {
+        bool was_published = is_published();
+        swap(values, newSet.values);
+        swap(occupied, newSet.occupied);
+        Seed = newSet.Seed;
+        num_elements = newSet.num_elements;
+        // the old table leaves the file once newSet drops it
+        if (was_published) publish();
+    }
+    return flag;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::resize() {
     if (!is_resize_allowed) throw std::runtime_error("Resize is not allowed!");
     for (uint32_t iteration = 0; iteration < MAX_TRIES; ++iteration) {
-        uint32_t seed = generate_seed();  // generate new seed
         // because 2xing the size won't resolve hash collision -- just make 2x fewer collisions in any bucket
+        // so every try also gets a new seed
 
-        // since operating big sized tables is just painful, increase the size linearly
-        // create new table with size (2 + i) * prev_size and previous seed, then add elements 1 by 1
-        HopscotchHashSet<T> newSet;
-        newSet.init(round((2 + iteration) * values.size()), seed);
-
-        bool flag = true;  // is resize successful
-        for (uint32_t i = 0; i < values.size(); ++i) {
-            if (values[i].first != default_value ||
-                (math_mod(i - bad_bucket_ind, values.size()) <
-                     HOP_RANGE  // add if elem != default_value or is a stored default_value
-                 && bit_check(bad_bucket_bitmap, i - bad_bucket_ind))) {
-                bool isAddSuccessful = newSet.tryadd(values[i].first);
-                if (!isAddSuccessful) {
-                    flag = false;
-                    break;
-                }
-            }
-        }
-        if (flag) {
-            swap(values, newSet.values);
-            Seed = newSet.Seed;
-            bad_bucket_bitmap = newSet.bad_bucket_bitmap;
-            bad_bucket_ind = newSet.bad_bucket_ind;
-            num_elements = newSet.num_elements;
+        // since operating big sized tables is just painful, the default policy
+        // increases the size linearly: (2 + i) * prev_size
+        if (try_rebuild(GrowthPolicy::next_size(values.size(), iteration),
+                        next_seed(Seed, iteration))) {
             return;
         }
     }
@@ -266,38 +494,279 @@ void HopscotchHashSet<T>::resize() {
     throw std::runtime_error("Error: Can not resize table");
 }
 
-template <typename T>
-bool HopscotchHashSet<T>::contains(T key) const {
-    int size = static_cast<int>(values.size());
-    uint32_t bucket_ind = myhash(key, Seed) % size;
-    uint32_t bucket_bitmap = values[bucket_ind].second;  // get bitmap
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::rehash(
+    size_type n) {
+    uint64_t min_size =
+        static_cast<uint64_t>(std::ceil(num_elements / max_load));
+    uint64_t size = GrowthPolicy::round_up(std::max<uint64_t>(n, min_size));
+    // first try keeps the seed, so rehash to the same size changes nothing
+    if (try_rebuild(size, Seed)) return;
+    for (uint32_t iteration = 0; iteration < MAX_TRIES; ++iteration) {
+        if (try_rebuild(GrowthPolicy::next_size(size, iteration),
+                        next_seed(Seed, iteration))) {
+            return;
+        }
+    }
+    throw std::runtime_error("Error: Can not rehash table");
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+bool HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::try_shrink(
+    uint64_t size) {
+    // a neighborhood has to fit into the table
+    size = GrowthPolicy::round_up(std::max<uint64_t>(size, HOP_RANGE));
+    // smaller table means fuller neighborhoods, if it doesn't fit try sizes
+    // between it and the current one, keeping the seed first
+    for (uint32_t iteration = 0; size < values.size() && iteration <= MAX_TRIES;
+         ++iteration) {
+        if (try_rebuild(size, iteration == 0 ? Seed : next_seed(Seed, iteration))) {
+            return true;
+        }
+        size = GrowthPolicy::next_size(size, 0);
+    }
+    return false;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::shrink_after_remove() {
+    if (!is_resize_allowed || !(num_elements < min_load * values.size())) {
+        return;
+    }
+    // a failed try is up to MAX_TRIES + 1 rebuilds, don't repeat it on every
+    // remove from the same table
+    if (values.size() == failed_shrink_size &&
+        num_elements > failed_shrink_elements / 2) {
+        return;
+    }
+    // land halfway to max_load, so adds don't grow it right back
+    if (!try_shrink(static_cast<uint64_t>(
+            std::ceil(num_elements / (max_load / 2))))) {
+        failed_shrink_size = values.size();
+        failed_shrink_elements = num_elements;
+    }
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+bool HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::shrink_to_fit() {
+    return try_shrink(
+        static_cast<uint64_t>(std::ceil(num_elements / max_load)));
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::reserve(
+    size_type n) {
+    uint64_t needed = static_cast<uint64_t>(std::ceil(n / max_load));
+    if (needed <= values.size()) return;
+    rehash(growth_detail::to_size<size_type>(needed));
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+bool HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::contains(
+    T key) const {
+    return contains_hashed(key, hash_of(key));
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::prefetch(
+    hash_type hash, int stage) const {
+    if (values.empty()) return;
+    size_type size = table_size();
+    size_type bucket_ind = GrowthPolicy::bucket(hash, size);
+    if (stage == 0) {
+        prefetch_read(&values[bucket_ind]);
+        return;
+    }
+    bitmap_type bucket_bitmap = values[bucket_ind].second;
+    if (bucket_bitmap) {
+        // slots in between share cache lines with one of the ends
+        uint32_t last = std::bit_width(bucket_bitmap) - 1;
+        prefetch_read(&values[(bucket_ind + last) % size]);
+    }
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+bool HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::contains_hashed(T key, hash_type hash) const {
+    [[maybe_unused]] uint32_t num_probes = 0;
+    bool is_found = find_slot(key, hash, &num_probes) != values.size();
+    counters.record_lookup(is_found, num_probes);
+    return is_found;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+typename HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                          Storage>::size_type
+HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::find_slot(
+    T key, hash_type hash, [[maybe_unused]] uint32_t* num_probes) const {
+    if (values.empty()) return 0;  // default table has no slots yet
+    size_type size = table_size();
+    size_type bucket_ind = GrowthPolicy::bucket(hash, size);
+    bitmap_type bucket_bitmap = values[bucket_ind].second;  // get bitmap
     // iterate through 1s in bucket_bitmap, check values inside
     while (bucket_bitmap) {
         uint32_t ind = minbit(bucket_bitmap);
+        if constexpr (hopscotch_stats_enabled) {
+            if (num_probes) ++*num_probes;
+        }
         if (values[(bucket_ind + ind) % size].first == key) {
-            return true;
+            return (bucket_ind + ind) % size;
         }
         bit_clear_change(bucket_bitmap, ind);
     }
-    return false;
+    return size;
 }
 
-template <typename T>
-void HopscotchHashSet<T>::remove(T key) {
-    uint32_t bucket_ind = myhash(key, Seed) % values.size();
-    uint32_t bucket_bitmap = values[bucket_ind].second;  // get bitmap
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+template <class F>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::for_each_key(
+    size_type first, size_type last, F&& f) const {
+    for (size_type i = first; i < last; ++i) {
+        if (is_occupied(i)) f(values[i].first);
+    }
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+template <class F>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::probe_aligned(
+    const HopscotchHashSet& other, size_type first, size_type last,
+    F&& f) const {
+    size_type size = table_size();
+    for (size_type bucket_ind = first; bucket_ind < last; ++bucket_ind) {
+        bitmap_type bucket_bitmap = values[bucket_ind].second;
+        bitmap_type other_bitmap = other.values[bucket_ind].second;
+        while (bucket_bitmap) {
+            T key = values[(bucket_ind + minbit(bucket_bitmap)) % size].first;
+            bool is_found = false;
+            for (bitmap_type bits = other_bitmap; bits; bits &= bits - 1) {
+                if (other.values[(bucket_ind + minbit(bits)) % size].first ==
+                    key) {
+                    is_found = true;
+                    break;
+                }
+            }
+            f(key, is_found);
+            bucket_bitmap &= bucket_bitmap - 1;
+        }
+    }
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>
+HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                 Storage>::empty_copy() const {
+    HopscotchHashSet res(ADD_RANGE, MAX_TRIES, Seed);
+    res.max_load = max_load;
+    res.min_load = min_load;
+    res.values = decltype(values)(values.get_allocator());
+    res.occupied = decltype(occupied)(occupied.get_allocator());
+    return res;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::set_memory_policy(const MemoryPolicy& policy) {
+    decltype(values) moved(values.begin(), values.end(),
+                           slot_allocator(policy));
+    values.swap(moved);
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::open(
+    const string& path) {
+    static_assert(Storage::is_mapped, "open needs MappedStorage");
+    // Storage:: keeps the file types out of heap-only users, they come with
+    // mapped_storage.h
+    auto file = Storage::file_type::open(
+        path, {sizeof(pair<T, bitmap_type>), HopRange, sizeof(SizeType)});
+    const auto* table = file->table();
+    if (!table) {
+        values = decltype(values)(file);
+        occupied = decltype(occupied)(file);
+        init(1024, Seed);
+        publish();
+        return;
+    }
+    values = decltype(values)(file, table->values_offset, table->values_size);
+    occupied = decltype(occupied)(file, table->occupied_offset,
+                                  table->occupied_size);
+    Seed = static_cast<uint32_t>(table->seed);
+    // the count isn't in the file, occupied is 1/64 of the slots
+    num_elements = 0;
+    for (uint64_t word : occupied) {
+        num_elements += std::popcount(word);
+    }
+    is_resize_allowed = true;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::sync() {
+    static_assert(Storage::is_mapped, "sync needs MappedStorage");
+    if (values.get_allocator()) values.get_allocator()->sync();
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+bool HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::is_published() const {
+    if constexpr (Storage::is_mapped) {
+        const auto& file = values.get_allocator();
+        return file && !values.empty() &&
+               file->is_active(values.file_offset());
+    } else {
+        return false;
+    }
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::publish() {
+    if constexpr (Storage::is_mapped) {
+        values.get_allocator()->publish(
+            {values.file_offset(), values.size(), occupied.file_offset(),
+             occupied.size(), Seed});
+    }
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                      Storage>::remove(T key) {
+    if (values.empty())
+        throw std::runtime_error("Tried to remove non-existent element");
+    size_type size = table_size();
+    size_type bucket_ind = GrowthPolicy::bucket(hash_of(key), size);
+    bitmap_type bucket_bitmap = values[bucket_ind].second;  // get bitmap
     for (
         uint32_t i = 0; i < HOP_RANGE;
         ++i) {  // minbit optimization slows things down here -- probably because overhead is too big
         if (bit_check(bucket_bitmap, i) &&
-            values[(bucket_ind + i) % values.size()].first == key) {
-            values[(bucket_ind + i) % values.size()].first = default_value;
+            values[(bucket_ind + i) % size].first == key) {
+            values[(bucket_ind + i) % size].first = default_value;
+            clear_occupied((bucket_ind + i) % size);
             bit_clear_change(values[bucket_ind].second, i);
-            if (bucket_ind == bad_bucket_ind)
-                bit_clear_change(bad_bucket_bitmap, i);
-            //bit_set_to_change(bad_bucket_bitmap, i, bit_check(bad_bucket_bitmap, i) * (bucket_ind == bad_bucket_ind));
-            // the line above works slower than if -- tested
             --num_elements;
+            shrink_after_remove();
             return;
         }
     }
@@ -306,65 +775,157 @@ void HopscotchHashSet<T>::remove(T key) {
     throw std::runtime_error("Tried to remove non-existent element");
 }
 
-template <typename T>
-bool HopscotchHashSet<T>::tryadd(
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+template <class Pred>
+typename HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                          Storage>::size_type
+HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::erase_if(
+    Pred pred, unsigned num_threads) {
+    size_type size = table_size();
+    if (size == 0) return 0;
+    num_threads = static_cast<unsigned>(std::clamp<uint64_t>(
+        num_threads, 1, std::max<uint64_t>(occupied.size(), 1)));
+    // walks occupied bits, so empty slots cost nothing; an erased key's home
+    // is the one bucket up to HOP_RANGE - 1 back whose bitmap points at it.
+    // A thread owns the occupied words of its range, bitmaps of the buckets
+    // just before it are shared with the thread of the previous range
+    bool is_shared = num_threads > 1;
+    auto has_bit = [&](size_type bucket, uint32_t i) {
+        if (is_shared) {
+            return bit_check(std::atomic_ref<bitmap_type>(values[bucket].second)
+                                 .load(std::memory_order_relaxed),
+                             i);
+        }
+        return bit_check(values[bucket].second, i);
+    };
+    auto clear_bit = [&](size_type bucket, uint32_t i) {
+        if (is_shared) {
+            std::atomic_ref<bitmap_type>(values[bucket].second)
+                .fetch_and(static_cast<bitmap_type>(~((bitmap_type)1 << i)),
+                           std::memory_order_relaxed);
+        } else {
+            bit_clear_change(values[bucket].second, i);
+        }
+    };
+    std::vector<size_type> erased(num_threads, 0);
+    std::vector<std::exception_ptr> errors(num_threads);
+    auto work = [&](unsigned part) {
+        uint64_t num_words = occupied.size();
+        size_type part_erased = 0;
+        try {
+            for (uint64_t word = num_words * part / num_threads;
+                 word < num_words * (part + 1) / num_threads; ++word) {
+                for (uint64_t bits = occupied[word]; bits; bits &= bits - 1) {
+                    size_type ind = static_cast<size_type>(
+                        word * 64 + std::countr_zero(bits));
+                    if (!pred(std::as_const(values[ind].first))) continue;
+                    size_type bucket = ind;
+                    uint32_t i = 0;
+                    while (!has_bit(bucket, i)) {
+                        bucket = bucket > 0 ? bucket - 1 : size - 1;
+                        ++i;
+                    }
+                    values[ind].first = default_value;
+                    clear_bit(bucket, i);
+                    clear_occupied(ind);
+                    ++part_erased;
+                }
+            }
+        } catch (...) {
+            errors[part] = std::current_exception();
+        }
+        erased[part] = part_erased;
+    };
+    std::vector<std::thread> threads{};
+    for (unsigned part = 1; part < num_threads; ++part) {
+        threads.emplace_back(work, part);
+    }
+    work(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // keys erased before a pred threw stay erased
+    size_type num_erased =
+        std::accumulate(erased.begin(), erased.end(), size_type{0});
+    num_elements -= num_erased;
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+    shrink_after_remove();
+    return num_erased;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+uint32_t
+HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType,
+                 Storage>::find_free_offset(
+    size_type start, uint32_t range) const {
+    size_type size = table_size();
+    uint32_t offset = 0;
+    size_type ind = start;
+    while (offset < range) {
+        // look at the rest of the current word, but not past range or the table end
+        uint32_t bit = ind & 63;
+        uint32_t len = static_cast<uint32_t>(std::min<uint64_t>(
+            {64 - bit, range - offset, static_cast<uint64_t>(size - ind)}));
+        uint64_t free_bits = ~occupied[ind >> 6] >> bit;
+        if (len < 64) free_bits &= ((uint64_t)1 << len) - 1;
+        if (free_bits) {
+            return offset + std::countr_zero(free_bits);
+        }
+        offset += len;
+        ind += len;
+        if (ind == size) ind = 0;
+    }
+    return range;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+bool HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::tryadd(
     T key) {  // true if successful, false if failed
     if (values.empty()) {
-        pair<T, uint32_t> temp = pair(key, 1);
+        pair<T, bitmap_type> temp = pair(key, 1);
         values.push_back(temp);
-        bad_bucket_bitmap = 1;
+        occupied.assign(1, 1);
         num_elements = 1;
+        counters.record_insert(0);
         return true;
     }
-    int size = static_cast<int>(values.size());
-    uint32_t bucket_ind = myhash(key, Seed) % size;
-    bool found = false;
-    uint32_t freeaddind;
-
-    for (uint32_t addind = 0;
-         static_cast<int>(addind) < std::min(static_cast<int>(ADD_RANGE), size);
-         ++addind) {  // std::min to avoid checking 1 position multiple times
-        // current index = bucket_ind + addind
-        // equals bad_bucket_ind + ..., 0 <= ... < HOP_RANGE
-        if (values[(bucket_ind + addind) % size].first == default_value &&
-            (math_mod(static_cast<int>(bucket_ind + addind - bad_bucket_ind),
-                      size) >= HOP_RANGE ||
-             !bit_check(bad_bucket_bitmap,
-                        math_mod(static_cast<int>(bucket_ind + addind -
-                                                  bad_bucket_ind),
-                                 size)))) {
-            // if default_value is not stored, then we found free space
-            found = true;
-            freeaddind = addind;
-            break;
-        }
-        // else default_value is stored, just do nothing
-    }
-
-    if (!found) {
-        // TODO change this to checking freeaddind instead -- code cleaning
+    size_type size = table_size();
+    size_type bucket_ind = GrowthPolicy::bucket(hash_of(key), size);
+    // std::min to avoid checking 1 position multiple times
+    uint32_t add_range =
+        static_cast<uint32_t>(std::min<uint64_t>(ADD_RANGE, size));
+    uint32_t freeaddind = find_free_offset(bucket_ind, add_range);
+
+    if (freeaddind == add_range) {
         return false;
     }
+    // whatever gets moved below, this slot ends up occupied
+    set_occupied((bucket_ind + freeaddind) % size);
 
     // otherwise found free space at bucket_ind + found_ind
     if (freeaddind < HOP_RANGE) {
         // we can insert without moving
         values[(bucket_ind + freeaddind) % size].first = key;
         bit_set_change(values[bucket_ind].second, freeaddind);
-        if (bucket_ind == bad_bucket_ind)
-            bad_bucket_bitmap = values[bad_bucket_ind].second;
         ++num_elements;
+        counters.record_insert(0);
         return true;
     }
 
     // else we have to move elements=
+    uint32_t num_moves = 0;
     while (freeaddind >= HOP_RANGE) {
         bool is_moved = false;
         // check from left to right to see if we can swap some element with free cell
         for (uint32_t i = HOP_RANGE - 1; i > 0; --i) {
             // look at bucket that is i places to the left, check if we can move something from this bucket to the right
-            uint32_t check_ind =
-                math_mod(static_cast<int>(bucket_ind + freeaddind - i), size);
+            // freeaddind >= HOP_RANGE > i, so this never goes below 0
+            size_type check_ind = (bucket_ind + freeaddind - i) % size;
             uint32_t minind = minbit(
                 values[check_ind]
                     .second);  // index of minimal bit in bucket check_ind
@@ -377,26 +938,32 @@ bool HopscotchHashSet<T>::tryadd(
                      values[(check_ind + i) % size].first);
                 freeaddind = freeaddind - i + minind;
                 is_moved = true;
+                ++num_moves;
                 break;
             }
         }
         if (!is_moved) {
-            // couldn't move empty space
+            // couldn't move empty space, it stays free wherever it ended up
+            clear_occupied((bucket_ind + freeaddind) % size);
             return false;
         }
     }
     // now that we moved elements, free space is in range HOP_RANGE
     values[(bucket_ind + freeaddind) % size].first = key;
     bit_set_change(values[bucket_ind].second, freeaddind);
-    if (bucket_ind == bad_bucket_ind)
-        bad_bucket_bitmap = values[bad_bucket_ind].second;
     ++num_elements;
+    counters.record_insert(num_moves);
     return true;
 }
 
-template <typename T>
-void HopscotchHashSet<T>::add(
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral SizeType, class Storage>
+void HopscotchHashSet<T, HopRange, GrowthPolicy, SizeType, Storage>::add(
     T key) {  // true if no resize happened, false if resize
+    if (is_resize_allowed && !values.empty() &&
+        num_elements + 1 > max_load * values.size()) {
+        resize();
+    }
     bool is_successful = tryadd(key);
     if (is_successful) return;
     //cout << "Starting resize sequence..." << endl;
@@ -409,11 +976,12 @@ void HopscotchHashSet<T>::add(
         ++iter_count;
     }
     // Failed to add element
-    uint32_t bucket_ind = myhash(key, Seed) % values.size();
+    size_type size = table_size();
+    size_type bucket_ind = GrowthPolicy::bucket(hash_of(key), size);
     T elem = values[bucket_ind].first;
     bool flag = true;  // check if we have HOP_RANGE + 1 equal elems
-    for (int i = 1; i < static_cast<int>(HOP_RANGE); ++i) {
-        uint32_t check_ind = math_mod(i + bucket_ind, values.size());
+    for (uint32_t i = 1; i < HOP_RANGE; ++i) {
+        size_type check_ind = (bucket_ind + i) % size;
         if (values[check_ind].first != elem) {
             flag = false;
             break;
@@ -423,4 +991,4 @@ void HopscotchHashSet<T>::add(
         throw std::runtime_error(
             "Error: You can't store more than HOP_RANGE equal elements");
     throw std::runtime_error("Error: Can not add element");
-}
\ No newline at end of file
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "hopscotch_bitmaps.h"
+
+// HopscotchHashSet with a counter next to every key: equal keys share one
+// slot instead of taking up to HOP_RANGE copies, so any key can be counted
+// any number of times.
+// Same key requirements as HopscotchHashSet (hashed by sizeof bytes).
+// A slot is free when its count is 0, so no separate occupied bitmap.
+template <typename T, uint32_t HopRange = 32,
+          class GrowthPolicy = LinearGrowthPolicy,
+          std::unsigned_integral Count = uint32_t>
+class HopscotchCountingSet {
+    static_assert(HopRange > 0 && HopRange <= 64,
+                  "HopRange must be in [1, 64]");
+
+   public:
+    using key_type = T;
+    using count_type = Count;
+    using bitmap_type = hop_bitmap_t<HopRange>;
+    static constexpr uint32_t HOP_RANGE = HopRange;
+
+    struct Slot {
+        T key{};
+        Count count = 0;         // 0 -- slot is free
+        bitmap_type bitmap = 0;  // keys whose home bucket is this slot
+    };
+
+   private:
+    // hopscotch parameters, same defaults as HopscotchHashSet
+    uint32_t ADD_RANGE = 128;
+    uint32_t MAX_TRIES = 5;
+    uint32_t Seed = default_seed;
+
+    uint32_t num_elements = 0;  // distinct keys
+    uint64_t total = 0;         // sum of all counts
+    double max_load = 1.0;
+
+    vector<Slot> slots;
+
+    [[no_unique_address]] mutable HopscotchCounters<> counters{};
+
+    void resize();
+    bool try_rebuild(uint64_t size, uint32_t seed);
+    // puts a key that isn't in the table yet, false if it didn't fit
+    bool tryadd(T key, Count count);
+    // slot index of key, slots.size() if it isn't there
+    uint32_t find(T key) const;
+
+   public:
+    HopscotchCountingSet() {}
+    HopscotchCountingSet(uint32_t init_ADD_RANGE, uint32_t init_MAX_TRIES,
+                         uint32_t init_Seed) {
+        ADD_RANGE = init_ADD_RANGE;
+        MAX_TRIES = init_MAX_TRIES;
+        Seed = init_Seed;
+    }
+
+    // returns the new count, throws if it would overflow Count
+    Count increment(T key, Count delta = 1);
+    // returns the remaining count, the key is removed when it reaches 0
+    // throws if key isn't there or delta is bigger than its count
+    Count decrement(T key, Count delta = 1);
+    // removes the key whatever its count, returns the count it had
+    Count erase(T key);
+    [[nodiscard]] Count count(T key) const;
+    [[nodiscard]] bool contains(T key) const { return count(key) != 0; }
+
+    void rehash(uint32_t n);   // rebuild with >= n slots, keeps max_load_factor
+    void reserve(uint32_t n);  // room for n distinct keys
+    [[nodiscard]] double max_load_factor() const { return max_load; }
+    void max_load_factor(double ml) {
+        if (!(ml > 0.0 && ml <= 1.0))
+            throw std::runtime_error("Max load factor must be in (0, 1]");
+        max_load = ml;
+    }
+
+    [[nodiscard]] uint32_t get_num_elements() const { return num_elements; }
+    [[nodiscard]] uint64_t total_count() const { return total; }
+    [[nodiscard]] double load_factor() const;
+    [[nodiscard]] HopscotchStats stats() const;
+    void reset_stats() { counters.reset(); }
+
+    // calls f(key, count) for every stored key, in slot order
+    template <class F>
+    void for_each(F&& f) const;
+};
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+double HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::load_factor()
+    const {
+    if (slots.empty()) return 0.0;
+    return static_cast<double>(num_elements) /
+           static_cast<double>(slots.size());
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+HopscotchStats HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::stats()
+    const {
+    HopscotchStats res;
+    counters.fill(res);
+    for (const auto& slot : slots) {
+        bitmap_type bitmap = slot.bitmap;
+        histogram_add(res.neighborhood_occupancy, std::popcount(bitmap));
+        while (bitmap) {
+            uint32_t ind = minbit(bitmap);
+            histogram_add(res.home_distances, ind);
+            bit_clear_change(bitmap, ind);
+        }
+    }
+    return res;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+template <class F>
+void HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::for_each(
+    F&& f) const {
+    for (const auto& slot : slots) {
+        if (slot.count) f(slot.key, slot.count);
+    }
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+uint32_t HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::find(
+    T key) const {
+    uint32_t size = slots.size();
+    if (size == 0) return 0;
+    uint32_t bucket_ind = GrowthPolicy::bucket(myhash(key, Seed), size);
+    bitmap_type bucket_bitmap = slots[bucket_ind].bitmap;
+    [[maybe_unused]] uint32_t num_probes = 0;
+    while (bucket_bitmap) {
+        uint32_t ind = (bucket_ind + minbit(bucket_bitmap)) % size;
+        if constexpr (hopscotch_stats_enabled) ++num_probes;
+        if (slots[ind].key == key) {
+            counters.record_lookup(true, num_probes);
+            return ind;
+        }
+        bucket_bitmap &= bucket_bitmap - 1;
+    }
+    counters.record_lookup(false, num_probes);
+    return size;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+Count HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::count(
+    T key) const {
+    uint32_t ind = find(key);
+    return ind < slots.size() ? slots[ind].count : 0;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+Count HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::increment(
+    T key, Count delta) {
+    uint32_t ind = find(key);
+    if (ind < slots.size()) {
+        if (delta > std::numeric_limits<Count>::max() - slots[ind].count)
+            throw std::runtime_error("Error: Count overflow");
+        slots[ind].count += delta;
+        total += delta;
+        return slots[ind].count;
+    }
+    if (delta == 0) return 0;  // nothing to count, don't take a slot
+
+    if (!slots.empty() && num_elements + 1 > max_load * slots.size()) {
+        resize();
+    }
+    if (!tryadd(key, delta)) {
+        uint32_t iter_count = 0;
+        while (true) {
+            if (iter_count++ == MAX_TRIES)
+                throw std::runtime_error("Error: Can not add element");
+            resize();
+            if (tryadd(key, delta)) break;
+        }
+    }
+    total += delta;
+    return delta;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+Count HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::decrement(
+    T key, Count delta) {
+    uint32_t ind = find(key);
+    if (ind == slots.size())
+        throw std::runtime_error("Tried to decrement non-existent element");
+    if (delta > slots[ind].count)
+        throw std::runtime_error("Tried to decrement below zero");
+    if (delta == slots[ind].count) {
+        erase(key);
+        return 0;
+    }
+    slots[ind].count -= delta;
+    total -= delta;
+    return slots[ind].count;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+Count HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::erase(T key) {
+    uint32_t size = slots.size();
+    if (size == 0) return 0;
+    uint32_t bucket_ind = GrowthPolicy::bucket(myhash(key, Seed), size);
+    bitmap_type bucket_bitmap = slots[bucket_ind].bitmap;
+    while (bucket_bitmap) {
+        uint32_t offset = minbit(bucket_bitmap);
+        Slot& slot = slots[(bucket_ind + offset) % size];
+        if (slot.key == key) {
+            Count res = slot.count;
+            slot.key = T{};
+            slot.count = 0;
+            bit_clear_change(slots[bucket_ind].bitmap, offset);
+            --num_elements;
+            total -= res;
+            return res;
+        }
+        bit_clear_change(bucket_bitmap, offset);
+    }
+    return 0;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+bool HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::tryadd(
+    T key, Count count) {
+    if (slots.empty()) {
+        slots.resize(GrowthPolicy::round_up(1024));
+    }
+    uint32_t size = slots.size();
+    uint32_t bucket_ind = GrowthPolicy::bucket(myhash(key, Seed), size);
+    uint32_t add_range = std::min(ADD_RANGE, size);
+    uint32_t freeaddind = 0;
+    while (freeaddind < add_range &&
+           slots[(bucket_ind + freeaddind) % size].count) {
+        ++freeaddind;
+    }
+    if (freeaddind == add_range) return false;
+
+    // bring the free slot into the neighborhood, same moves as HopscotchHashSet
+    uint32_t num_moves = 0;
+    while (freeaddind >= HOP_RANGE) {
+        bool is_moved = false;
+        for (uint32_t i = HOP_RANGE - 1; i > 0; --i) {
+            uint32_t check_ind =
+                math_mod(static_cast<int>(bucket_ind + freeaddind - i), size);
+            bitmap_type& check_bitmap = slots[check_ind].bitmap;
+            uint32_t minind = minbit(check_bitmap);
+            if (check_bitmap && minind < i) {
+                bit_clear_change(check_bitmap, minind);
+                bit_set_change(check_bitmap, i);
+                Slot& from = slots[(check_ind + minind) % size];
+                Slot& to = slots[(check_ind + i) % size];
+                swap(from.key, to.key);
+                swap(from.count, to.count);
+                freeaddind = freeaddind - i + minind;
+                is_moved = true;
+                ++num_moves;
+                break;
+            }
+        }
+        if (!is_moved) return false;
+    }
+    Slot& slot = slots[(bucket_ind + freeaddind) % size];
+    slot.key = key;
+    slot.count = count;
+    bit_set_change(slots[bucket_ind].bitmap, freeaddind);
+    ++num_elements;
+    counters.record_insert(num_moves);
+    return true;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+bool HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::try_rebuild(
+    uint64_t size, uint32_t seed) {
+    HopscotchCountingSet newSet(ADD_RANGE, MAX_TRIES, seed);
+    newSet.slots.resize(
+        growth_detail::to_size<uint32_t>(GrowthPolicy::round_up(size)));
+    bool flag = true;
+    for (const auto& slot : slots) {
+        if (slot.count && !newSet.tryadd(slot.key, slot.count)) {
+            flag = false;
+            break;
+        }
+    }
+    counters.record_resize_attempt(flag);
+    if (flag) {
+        swap(slots, newSet.slots);
+        Seed = newSet.Seed;
+    }
+    return flag;
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+void HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::resize() {
+    for (uint32_t iteration = 0; iteration < MAX_TRIES; ++iteration) {
+        if (try_rebuild(GrowthPolicy::next_size(slots.size(), iteration),
+                        next_seed(Seed, iteration))) {
+            return;
+        }
+    }
+    throw std::runtime_error("Error: Can not resize table");
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+void HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::rehash(
+    uint32_t n) {
+    uint64_t min_size =
+        static_cast<uint64_t>(std::ceil(num_elements / max_load));
+    uint64_t size = GrowthPolicy::round_up(std::max<uint64_t>(n, min_size));
+    if (try_rebuild(size, Seed)) return;
+    for (uint32_t iteration = 0; iteration < MAX_TRIES; ++iteration) {
+        if (try_rebuild(GrowthPolicy::next_size(size, iteration),
+                        next_seed(Seed, iteration))) {
+            return;
+        }
+    }
+    throw std::runtime_error("Error: Can not rehash table");
+}
+
+template <typename T, uint32_t HopRange, class GrowthPolicy,
+          std::unsigned_integral Count>
+void HopscotchCountingSet<T, HopRange, GrowthPolicy, Count>::reserve(
+    uint32_t n) {
+    uint64_t needed = static_cast<uint64_t>(std::ceil(n / max_load));
+    if (needed <= slots.size()) return;
+    rehash(growth_detail::to_size<uint32_t>(needed));
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+// Growth policies pick table sizes and map a hash to its home bucket.
+// Every policy has:
+//   round_up(n)             -- smallest size the policy allows that is >= n
+//   next_size(size, tries)  -- size for the tries-th attempt to grow this size
+//   bucket(hash, size)      -- home bucket, size is always a round_up result
+//   is_power_of_two         -- sizes are 2^n, tables can wrap indices with a mask
+// Sizes are 64-bit here, a table turns them into its size_type with
+// growth_detail::to_size. bucket is done in the size_type of the table, so
+// 32-bit tables keep 32-bit arithmetic on lookups.
+
+namespace growth_detail {
+
+// sizes saturate here instead of wrapping around
+constexpr uint64_t kMaxSize = uint64_t{1} << 63;
+
+inline uint64_t clamp_size(uint64_t size) { return std::min(size, kMaxSize); }
+
+// largest table with this size_type, indices like bucket + offset (always
+// below 2 * size) must not overflow it
+template <std::unsigned_integral Size>
+constexpr uint64_t max_size() {
+    return static_cast<uint64_t>(std::numeric_limits<Size>::max()) / 2 + 1;
+}
+
+// size as the size_type of a table, throws if the table can't be that big
+template <std::unsigned_integral Size>
+Size to_size(uint64_t size) {
+    if (size > max_size<Size>()) {
+        throw std::runtime_error(
+            "Table size doesn't fit its size_type, use a 64-bit one");
+    }
+    return static_cast<Size>(size);
+}
+
+}  // namespace growth_detail
+
+// sizes 2^n, bucket is a mask -- cheapest, but only low bits of the hash matter
+struct PowerOfTwoGrowthPolicy {
+    static constexpr bool is_power_of_two = true;
+
+    static uint64_t round_up(uint64_t n) {
+        return std::bit_ceil(
+            std::clamp<uint64_t>(n, 1, growth_detail::kMaxSize));
+    }
+    static uint64_t next_size(uint64_t size, uint32_t tries) {
+        uint32_t shift = std::min<uint32_t>(tries + 1, 63);
+        return size > (growth_detail::kMaxSize >> shift)
+                   ? growth_detail::kMaxSize
+                   : size << shift;
+    }
+    template <std::unsigned_integral Size>
+    static Size bucket(uint64_t hash, Size size) {
+        return static_cast<Size>(hash & (size - 1));
+    }
+};
+
+// multiplies the size by Num/Den on every try, any size is allowed
+template <uint32_t Num, uint32_t Den>
+struct FactorGrowthPolicy {
+    static_assert(Num > Den && Den > 0, "growth factor must be > 1");
+    static constexpr bool is_power_of_two = false;
+
+    static uint64_t round_up(uint64_t n) {
+        return growth_detail::clamp_size(std::max<uint64_t>(n, 1));
+    }
+    static uint64_t next_size(uint64_t size, uint32_t tries) {
+        uint64_t res = size;
+        for (uint32_t i = 0; i <= tries; ++i) {
+            if (res >= growth_detail::kMaxSize / Num) {
+                return growth_detail::kMaxSize;
+            }
+            res = std::max(res * Num / Den, res + 1);
+        }
+        return res;
+    }
+    template <std::unsigned_integral Size>
+    static Size bucket(uint64_t hash, Size size) {
+        return static_cast<Size>(hash % size);
+    }
+};
+
+using OneAndHalfGrowthPolicy = FactorGrowthPolicy<3, 2>;
+
+// primes that roughly double, so a weak hash still spreads over all buckets
+struct PrimeGrowthPolicy {
+    static constexpr bool is_power_of_two = false;
+
+    // past 2^32 they keep doubling, only 64-bit tables get there
+    static constexpr std::array<uint64_t, 39> primes{
+        5u,           11u,           23u,           53u,
+        97u,          193u,          389u,          769u,
+        1543u,        3079u,         6151u,         12289u,
+        24593u,       49157u,        98317u,        196613u,
+        393241u,      786433u,       1572869u,      3145739u,
+        6291469u,     12582917u,     25165843u,     50331653u,
+        100663319u,   201326611u,    402653189u,    805306457u,
+        1610612741u,  3221225473u,   4294967291u,   8589934583u,
+        17179869209u, 34359738421u,  68719476851u,  137438953711u,
+        274877907427u, 549755814877u, 1099511629763u};
+
+    // throws past the last prime, a smaller size would only fail later
+    static uint64_t round_up(uint64_t n) {
+        auto it = std::lower_bound(primes.begin(), primes.end(), n);
+        if (it == primes.end()) {
+            throw std::length_error(
+                "Table size is past the largest prime of PrimeGrowthPolicy");
+        }
+        return *it;
+    }
+    // kMaxSize is past the last prime too, so that grow throws as well
+    static uint64_t next_size(uint64_t size, uint32_t tries) {
+        uint32_t shift = std::min<uint32_t>(tries + 1, 63);
+        return round_up(size > (growth_detail::kMaxSize >> shift)
+                            ? growth_detail::kMaxSize
+                            : (size << shift) - 1);
+    }
+    template <std::unsigned_integral Size>
+    static Size bucket(uint64_t hash, Size size) {
+        return static_cast<Size>(hash % size);
+    }
+};
+
+// what HopscotchHashSet always did: try (2 + tries) * size, any size is allowed
+struct LinearGrowthPolicy {
+    static constexpr bool is_power_of_two = false;
+
+    static uint64_t round_up(uint64_t n) {
+        return growth_detail::clamp_size(std::max<uint64_t>(n, 1));
+    }
+    static uint64_t next_size(uint64_t size, uint32_t tries) {
+        uint64_t factor = 2 + tries;
+        return size >= growth_detail::kMaxSize / factor
+                   ? growth_detail::kMaxSize
+                   : size * factor;
+    }
+    template <std::unsigned_integral Size>
+    static Size bucket(uint64_t hash, Size size) {
+        return static_cast<Size>(hash % size);
+    }
+};
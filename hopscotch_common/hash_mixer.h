@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// What HopscotchShadow does to a hash before GrowthPolicy::bucket takes its
+// low bits (or its remainder). libstdc++ std::hash of an integer is the
+// integer itself, so sequential or strided keys go to predictable buckets:
+// keys a multiple of the table size apart all share one home, and inserts
+// run out of add_range. A mixer spreads every input bit over the low bits.
+// Every mixer is a bijection of uint64_t, so distinct hashes stay distinct.
+// seed changes which bijection it is, 0 is as good as any other.
+
+// NoMixing -- the hash as the hasher gives it, the default
+struct NoMixing {
+    static uint64_t mix(uint64_t hash, uint64_t /*seed*/) { return hash; }
+};
+
+// FibonacciMixing -- one multiply by 2^64 / phi, then the high half is folded
+// onto the low one, since a product's low bits only see the input's low bits
+struct FibonacciMixing {
+    static uint64_t mix(uint64_t hash, uint64_t seed) {
+        hash = (hash ^ seed) * 0x9E3779B97F4A7C15ull;
+        return hash ^ (hash >> 32);
+    }
+};
+
+// Murmur3Mixing -- murmur3's 64-bit finalizer, two multiplies, every input
+// bit flips each output bit with probability close to 1/2
+struct Murmur3Mixing {
+    static uint64_t mix(uint64_t hash, uint64_t seed) {
+        hash ^= seed;
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Compile with -DHOPSCOTCH_STATS to make tables count probes, displacements and resizes.
+// Without it the counters are empty no-op structs, and stats() only reports
+// what can be read from the table itself (tombstones and neighborhoods).
+#ifdef HOPSCOTCH_STATS
+constexpr bool hopscotch_stats_enabled = true;
+#else
+constexpr bool hopscotch_stats_enabled = false;
+#endif
+
+// snapshot of table internals, every histogram is indexed by the measured value
+struct HopscotchStats {
+    std::vector<uint64_t> hit_probe_lengths{};   // keys compared on successful lookup
+    std::vector<uint64_t> miss_probe_lengths{};  // keys compared on failed lookup
+    std::vector<uint64_t> displacement_steps{};  // moves per successful insert
+    uint64_t resize_attempts = 0;  // every try to build a bigger table
+    uint64_t resize_failures = 0;  // tries that didn't fit all keys
+    uint64_t tombstone_count = 0;
+    std::vector<uint64_t> neighborhood_occupancy{};  // keys per home bucket -> buckets
+    std::vector<uint64_t> home_distances{};  // distance of a key from its home bucket -> keys
+};
+
+inline void histogram_add(std::vector<uint64_t>& histogram, uint64_t value,
+                          uint64_t count = 1) {
+    if (histogram.size() <= value) histogram.resize(value + 1, 0);
+    histogram[value] += count;
+}
+
+// flat "name value" lines, easy to feed into a metrics pipeline
+inline void print_stats(std::ostream& os, const HopscotchStats& stats,
+                        const std::string& prefix = "hopscotch") {
+    auto print_histogram = [&](const std::string& name,
+                               const std::vector<uint64_t>& histogram) {
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            if (histogram[i]) {
+                os << prefix << "_" << name << "{value=\"" << i << "\"} "
+                   << histogram[i] << "\n";
+            }
+        }
+    };
+    print_histogram("hit_probe_length", stats.hit_probe_lengths);
+    print_histogram("miss_probe_length", stats.miss_probe_lengths);
+    print_histogram("displacement_steps", stats.displacement_steps);
+    os << prefix << "_resize_attempts " << stats.resize_attempts << "\n";
+    os << prefix << "_resize_failures " << stats.resize_failures << "\n";
+    os << prefix << "_tombstones " << stats.tombstone_count << "\n";
+    print_histogram("neighborhood_occupancy", stats.neighborhood_occupancy);
+    print_histogram("home_distance", stats.home_distances);
+}
+
+// counters that live inside a table, the disabled version compiles to nothing
+template <bool Enabled = hopscotch_stats_enabled>
+struct HopscotchCounters {
+    std::vector<uint64_t> hit_probe_lengths{};
+    std::vector<uint64_t> miss_probe_lengths{};
+    std::vector<uint64_t> displacement_steps{};
+    uint64_t resize_attempts = 0;
+    uint64_t resize_failures = 0;
+
+    void record_lookup(bool found, uint32_t probes) {
+        histogram_add(found ? hit_probe_lengths : miss_probe_lengths, probes);
+    }
+    void record_insert(uint32_t displacements) {
+        histogram_add(displacement_steps, displacements);
+    }
+    void record_resize_attempt(bool is_successful) {
+        ++resize_attempts;
+        resize_failures += !is_successful;
+    }
+    void fill(HopscotchStats& stats) const {
+        stats.hit_probe_lengths = hit_probe_lengths;
+        stats.miss_probe_lengths = miss_probe_lengths;
+        stats.displacement_steps = displacement_steps;
+        stats.resize_attempts = resize_attempts;
+        stats.resize_failures = resize_failures;
+    }
+    void reset() { *this = HopscotchCounters{}; }
+};
+
+template <>
+struct HopscotchCounters<false> {
+    void record_lookup(bool, uint32_t) {}
+    void record_insert(uint32_t) {}
+    void record_resize_attempt(bool) {}
+    void fill(HopscotchStats&) const {}
+    void reset() {}
+};
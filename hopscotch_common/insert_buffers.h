@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Front end for many threads inserting into one HopscotchShadow or
+// HopscotchHashSet. Each thread has a Producer that collects keys, sorts them
+// by home bucket and inserts the whole batch under one lock, so the lock is
+// taken once per batch_size keys and neighboring inserts hit the same lines.
+//
+// Visibility: a key is in the table once the flush that took it returns,
+// flushes run when a buffer fills, on flush() and when a Producer is
+// destroyed. Other threads see it through read(), which takes the same lock.
+// Keys of one producer are inserted in the order of their home buckets, not
+// in the order they came, which only matters to HopscotchHashSet, where
+// every add of an equal key is stored.
+// Table needs: key_type, growth_policy, bucket_count, hash_key, empty_copy,
+// and insert or add.
+template <class Table>
+class InsertBuffers {
+   public:
+    using key_type = typename Table::key_type;
+
+    // one per producer thread, must not outlive the InsertBuffers
+    class Producer {
+       public:
+        Producer(Producer&& other) noexcept
+            : owner(std::exchange(other.owner, nullptr)),
+              keys(std::move(other.keys)),
+              sorted(std::move(other.sorted)),
+              layout(std::move(other.layout)),
+              num_buckets(other.num_buckets) {}
+        Producer& operator=(Producer&& other) = delete;
+        // flushes what is left, a failed insert there terminates, call
+        // flush() first to get the exception
+        ~Producer() {
+            if (owner) flush();
+        }
+
+        void insert(const key_type& key) {
+            keys.push_back(key);
+            if (keys.size() >= owner->batch_size) flush();
+        }
+        // every key given so far is in the table; if an insert throws, the
+        // keys before it stay in and only the rest stay buffered
+        void flush();
+        size_t num_buffered() const { return keys.size(); }
+
+       private:
+        friend class InsertBuffers;
+        Producer(InsertBuffers* init_owner, Table init_layout,
+                 uint64_t init_num_buckets)
+            : owner(init_owner),
+              layout(std::in_place, std::move(init_layout)),
+              num_buckets(init_num_buckets) {}
+
+        InsertBuffers* owner;
+        std::vector<key_type> keys{};
+        // {home bucket, key}, kept to reuse its memory
+        std::vector<std::pair<uint64_t, key_type>> sorted{};
+        // hashes like the table did at the last flush, read without the lock;
+        // optional since HopscotchHashSet can't be assigned
+        std::optional<Table> layout;
+        uint64_t num_buckets;
+    };
+
+    explicit InsertBuffers(Table& init_table, size_t init_batch_size = 4096)
+        : table(init_table),
+          batch_size(std::max<size_t>(init_batch_size, 1)) {}
+    InsertBuffers(const InsertBuffers&) = delete;
+    InsertBuffers& operator=(const InsertBuffers&) = delete;
+
+    // takes the lock once, to see how the table hashes
+    Producer make_producer() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return Producer(this, table.empty_copy(), table.bucket_count());
+    }
+
+    // f(const Table&) under the lock, sees every finished flush
+    template <class F>
+    decltype(auto) read(F&& f) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return f(static_cast<const Table&>(table));
+    }
+
+   private:
+    static void insert_into(Table& table, const key_type& key) {
+        if constexpr (requires { table.add(key); }) {
+            table.add(key);
+        } else {
+            table.insert(key);
+        }
+    }
+
+    Table& table;
+    size_t batch_size;
+    mutable std::mutex mutex{};
+};
+
+template <class Table>
+void InsertBuffers<Table>::Producer::flush() {
+    if (keys.empty()) return;
+    sorted.clear();
+    for (const key_type& key : keys) {
+        // a table that grew or changed its seed since only spoils the order
+        uint64_t home =
+            num_buckets == 0
+                ? 0
+                : Table::growth_policy::bucket(layout->hash_key(key),
+                                               num_buckets);
+        sorted.emplace_back(home, key);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::lock_guard<std::mutex> lock(owner->mutex);
+    size_t num_inserted = 0;
+    try {
+        for (const auto& [home, key] : sorted) {
+            insert_into(owner->table, key);
+            ++num_inserted;
+        }
+    } catch (...) {
+        // only what didn't go in stays buffered, a retry or the destructor
+        // must not add the rest again
+        keys.clear();
+        for (size_t i = num_inserted; i < sorted.size(); ++i) {
+            keys.push_back(sorted[i].second);
+        }
+        throw;
+    }
+    keys.clear();
+    if (owner->table.bucket_count() != num_buckets) {
+        layout.emplace(owner->table.empty_copy());
+        num_buckets = owner->table.bucket_count();
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// AMAC-style lookups: Width coroutines each own one key in flight, prefetch
+// the next line the lookup needs and suspend, so Width cache misses overlap
+// instead of waiting one after another.
+// Table needs (both hopscotch tables have them):
+//   hash_key(key)                -- hash reused by every later step
+//   prefetch(hash, stage)        -- for stage in [0, prefetch_stages)
+//   contains_hashed(key, hash)   -- the ordinary lookup, lines already cached
+// Only pays off when the table is far bigger than the LLC, for small tables
+// plain contains is faster.
+
+namespace pipeline_detail {
+
+// bare coroutine handle owner, starts suspended, rethrows from the worker
+struct LookupTask {
+    struct promise_type {
+        std::exception_ptr error{};
+
+        LookupTask get_return_object() {
+            return LookupTask{
+                std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    explicit LookupTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+    LookupTask(LookupTask&& other) noexcept
+        : handle(std::exchange(other.handle, {})) {}
+    LookupTask(const LookupTask&) = delete;
+    LookupTask& operator=(const LookupTask&) = delete;
+    LookupTask& operator=(LookupTask&&) = delete;
+    ~LookupTask() {
+        if (handle) handle.destroy();
+    }
+
+    // rethrows what the worker threw, once it is done
+    void check() const {
+        if (handle.promise().error) {
+            std::rethrow_exception(handle.promise().error);
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+}  // namespace pipeline_detail
+
+// Width long-lived workers pull keys from a shared cursor, so coroutine frames
+// are allocated once per run, not once per key
+template <class Table, size_t Width = 16>
+class LookupPipeline {
+    static_assert(Width > 0, "pipeline needs at least one lookup in flight");
+    static_assert(Table::prefetch_stages >= 0 && Table::prefetch_stages <= 3,
+                  "pipeline unrolls at most 3 prefetch stages");
+
+   public:
+    explicit LookupPipeline(const Table& table) : table(table) {}
+
+    // calls sink(index, found) for every key in [first, last), index is the
+    // position in the range; results come out of order
+    template <std::forward_iterator It, class Sink>
+    void run(It first, It last, Sink&& sink) const;
+
+    // found flags in key order
+    template <std::forward_iterator It>
+    std::vector<bool> contains(It first, It last) const;
+
+   private:
+    template <class It>
+    struct Cursor {
+        It it;
+        It last;
+        size_t index;
+    };
+
+    template <class It, class Sink>
+    pipeline_detail::LookupTask worker(Cursor<It>& cursor, Sink& sink) const;
+
+    const Table& table;
+};
+
+template <class Table, size_t Width>
+template <class It, class Sink>
+pipeline_detail::LookupTask LookupPipeline<Table, Width>::worker(
+    Cursor<It>& cursor, Sink& sink) const {
+    while (cursor.it != cursor.last) {
+        size_t index = cursor.index++;
+        auto key = *cursor.it;
+        ++cursor.it;
+        auto hash = table.hash_key(key);
+        // unrolled, so prefetch sees a constant stage -- with a runtime loop
+        // over stages gcc 12 made the whole pipeline 2.5x slower
+        if constexpr (Table::prefetch_stages > 0) {
+            table.prefetch(hash, 0);
+            co_await std::suspend_always{};
+        }
+        if constexpr (Table::prefetch_stages > 1) {
+            table.prefetch(hash, 1);
+            co_await std::suspend_always{};
+        }
+        if constexpr (Table::prefetch_stages > 2) {
+            table.prefetch(hash, 2);
+            co_await std::suspend_always{};
+        }
+        sink(index, table.contains_hashed(key, hash));
+    }
+}
+
+template <class Table, size_t Width>
+template <std::forward_iterator It, class Sink>
+void LookupPipeline<Table, Width>::run(It first, It last, Sink&& sink) const {
+    Cursor<It> cursor{first, last, 0};
+    std::vector<pipeline_detail::LookupTask> workers{};
+    workers.reserve(Width);
+    for (size_t i = 0; i < Width; ++i) {
+        workers.push_back(worker(cursor, sink));
+    }
+    // round-robin, every worker gets one step while the others' lines load,
+    // finished workers are swapped out of the active part
+    std::array<pipeline_detail::LookupTask*, Width> active{};
+    for (size_t i = 0; i < Width; ++i) {
+        active[i] = &workers[i];
+    }
+    size_t num_active = Width;
+    while (num_active > 0) {
+        for (size_t i = 0; i < num_active;) {
+            active[i]->handle.resume();
+            if (active[i]->handle.done()) {
+                active[i]->check();
+                active[i] = active[--num_active];
+            } else {
+                ++i;
+            }
+        }
+    }
+}
+
+template <class Table, size_t Width>
+template <std::forward_iterator It>
+std::vector<bool> LookupPipeline<Table, Width>::contains(It first,
+                                                         It last) const {
+    std::vector<bool> res(std::distance(first, last));
+    run(first, last, [&res](size_t index, bool found) { res[index] = found; });
+    return res;
+}
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memory_policy.h"
+
+// Table storage in a memory-mapped file, so a table survives restarts without
+// a load step and can be bigger than RAM, the page cache decides what stays
+// in memory.
+//
+// The file is a header page, then regions, each the array of one table
+// (slots or occupied words), mapped on its own so growing the file never
+// moves a mapping. New regions go at the end of the file. The header holds
+// two table descriptors, a rebuild writes the inactive one after its regions
+// are on disk, then switches the active index with one aligned store. Regions
+// the active table doesn't use are punched out of the file once dropped.
+// The key count isn't stored, open counts the occupied bits, which is 1/64
+// of the slots to read.
+// Keys are stored as raw bytes, so slots must be trivially copyable, and the
+// layout (slot size, hop range, size type) must match to reopen a file.
+
+// what a file holds, checked on open
+struct MappedLayout {
+    uint64_t slot_size = 0;
+    uint64_t hop_range = 0;
+    uint64_t size_type_size = 0;
+
+    bool operator==(const MappedLayout&) const = default;
+};
+
+// one table in the file, sizes in elements
+struct MappedTable {
+    uint64_t values_offset = 0;
+    uint64_t values_size = 0;
+    uint64_t occupied_offset = 0;
+    uint64_t occupied_size = 0;
+    uint64_t seed = 0;
+};
+
+class MappedFile {
+   public:
+    // creates path if it doesn't exist, throws if it holds another layout
+    static std::shared_ptr<MappedFile> open(const std::string& path,
+                                            const MappedLayout& layout);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // nullptr until the first publish
+    const MappedTable* table() const;
+    // the region at offset belongs to table()
+    bool is_active(uint64_t offset) const;
+
+    // a new region of bytes at the end of the file, mapped
+    std::pair<uint64_t, void*> allocate(uint64_t bytes);
+    // maps a region that is already there
+    void* map(uint64_t offset, uint64_t bytes);
+    // unmaps, and frees the disk blocks unless the active table uses it
+    void release(uint64_t offset, uint64_t bytes, void* addr);
+
+    // table becomes the one open finds: its regions go to disk first, then
+    // the header switches to it in one store
+    void publish(const MappedTable& new_table);
+    // every mapped region and the header to disk
+    void sync();
+
+   private:
+    struct Header {
+        uint64_t magic;
+        uint64_t version;
+        MappedLayout layout;
+        uint64_t file_end;  // new regions start here
+        uint64_t active;    // descriptor in use, kNoTable before the first
+        MappedTable tables[2];
+    };
+    static constexpr uint64_t kMagic = 0x484F505343544348;  // "HOPSCTCH"
+    static constexpr uint64_t kVersion = 1;
+    static constexpr uint64_t kNoTable = 2;
+
+    MappedFile(int init_fd, Header* init_header)
+        : fd(init_fd), header(init_header) {}
+
+    static uint64_t page_size() {
+        return static_cast<uint64_t>(sysconf(_SC_PAGE_SIZE));
+    }
+    static uint64_t round_to_pages(uint64_t bytes) {
+        return (bytes + page_size() - 1) / page_size() * page_size();
+    }
+    [[noreturn]] static void fail(const std::string& what) {
+        throw std::runtime_error(what + ": " + std::strerror(errno));
+    }
+    void sync_header() const;
+
+    int fd;
+    Header* header;
+    // region offset -> {address, mapped length}
+    std::map<uint64_t, std::pair<void*, uint64_t>> mappings{};
+};
+
+inline std::shared_ptr<MappedFile> MappedFile::open(
+    const std::string& path, const MappedLayout& layout) {
+    static_assert(sizeof(Header) <= 4096, "header must fit one page");
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) fail("can't open " + path);
+    auto close_and_fail = [&](const std::string& what) {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        fail(what + " " + path);
+    };
+    struct stat st;
+    if (fstat(fd, &st) != 0) close_and_fail("can't stat");
+    bool is_new = st.st_size == 0;
+    if (is_new && ftruncate(fd, static_cast<off_t>(page_size())) != 0) {
+        close_and_fail("can't grow");
+    }
+    void* addr = mmap(nullptr, page_size(), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) close_and_fail("can't map");
+    auto* header = static_cast<Header*>(addr);
+    if (is_new) {
+        *header = Header{};
+        header->magic = kMagic;
+        header->version = kVersion;
+        header->layout = layout;
+        header->file_end = page_size();
+        header->active = kNoTable;
+    } else if (header->magic != kMagic || header->version != kVersion ||
+               !(header->layout == layout)) {
+        munmap(addr, page_size());
+        ::close(fd);
+        throw std::runtime_error(path + " holds another kind of table");
+    }
+    std::shared_ptr<MappedFile> res(new MappedFile(fd, header));
+    if (is_new) res->sync_header();
+    return res;
+}
+
+inline MappedFile::~MappedFile() {
+    for (const auto& [offset, mapping] : mappings) {
+        munmap(mapping.first, mapping.second);
+    }
+    munmap(header, page_size());
+    ::close(fd);
+}
+
+inline const MappedTable* MappedFile::table() const {
+    if (header->active == kNoTable) return nullptr;
+    return &header->tables[header->active];
+}
+
+inline std::pair<uint64_t, void*> MappedFile::allocate(uint64_t bytes) {
+    uint64_t offset = header->file_end;
+    uint64_t end = offset + round_to_pages(bytes);
+    if (ftruncate(fd, static_cast<off_t>(end)) != 0) {
+        fail("can't grow table file");
+    }
+    header->file_end = end;
+    return {offset, map(offset, bytes)};
+}
+
+inline void* MappedFile::map(uint64_t offset, uint64_t bytes) {
+    uint64_t length = round_to_pages(bytes);
+    void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                      static_cast<off_t>(offset));
+    if (addr == MAP_FAILED) fail("can't map table file");
+    mappings[offset] = {addr, length};
+    return addr;
+}
+
+inline void MappedFile::release(uint64_t offset, uint64_t bytes,
+                                void* addr) {
+    uint64_t length = round_to_pages(bytes);
+    munmap(addr, length);
+    mappings.erase(offset);
+    if (is_active(offset)) return;
+#if defined(FALLOC_FL_PUNCH_HOLE)
+    // filesystems without holes just keep the blocks
+    fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              static_cast<off_t>(offset), static_cast<off_t>(length));
+#endif
+}
+
+inline void MappedFile::publish(const MappedTable& new_table) {
+    for (uint64_t offset : {new_table.values_offset,
+                            new_table.occupied_offset}) {
+        auto it = mappings.find(offset);
+        if (it == mappings.end()) continue;
+        if (msync(it->second.first, it->second.second, MS_SYNC) != 0) {
+            fail("can't write table file");
+        }
+    }
+    uint64_t next = header->active == 0 ? 1 : 0;
+    header->tables[next] = new_table;
+    sync_header();
+    std::atomic_ref<uint64_t>(header->active)
+        .store(next, std::memory_order_release);
+    sync_header();
+}
+
+inline void MappedFile::sync() {
+    for (const auto& [offset, mapping] : mappings) {
+        if (msync(mapping.first, mapping.second, MS_SYNC) != 0) {
+            fail("can't write table file");
+        }
+    }
+    sync_header();
+}
+
+inline void MappedFile::sync_header() const {
+    if (msync(header, page_size(), MS_SYNC) != 0) {
+        fail("can't write table file header");
+    }
+}
+
+inline bool MappedFile::is_active(uint64_t offset) const {
+    const MappedTable* active = table();
+    return active && (active->values_offset == offset ||
+                      active->occupied_offset == offset);
+}
+
+// the part of std::vector that HopscotchHashSet uses, over a region of a
+// MappedFile; get_allocator is the file, new arrays go into the same one
+template <class U>
+class MappedVector {
+    // std::pair of such types too, its assignment is the only nontrivial part
+    static_assert(std::is_trivially_copy_constructible_v<U> &&
+                      std::is_trivially_destructible_v<U>,
+                  "mapped tables store slots as raw bytes");
+
+   public:
+    using value_type = U;
+    using allocator_type = std::shared_ptr<MappedFile>;
+
+    MappedVector() = default;
+    explicit MappedVector(std::shared_ptr<MappedFile> init_file)
+        : file(std::move(init_file)) {}
+    // a region that is already in the file
+    MappedVector(std::shared_ptr<MappedFile> init_file, uint64_t init_offset,
+                 uint64_t init_size)
+        : file(std::move(init_file)), offset(init_offset), num(init_size) {
+        if (num > 0) {
+            elems = static_cast<U*>(file->map(offset, num * sizeof(U)));
+        }
+    }
+    // a copy gets its own region of the same file
+    MappedVector(const MappedVector& other) : file(other.file) {
+        assign_from(other.elems, other.num);
+    }
+    MappedVector(MappedVector&& other) noexcept { swap(other); }
+    MappedVector& operator=(MappedVector other) noexcept {
+        swap(other);
+        return *this;
+    }
+    ~MappedVector() { release(); }
+
+    allocator_type get_allocator() const { return file; }
+    uint64_t file_offset() const { return offset; }
+
+    size_t size() const { return num; }
+    bool empty() const { return num == 0; }
+    U* data() { return elems; }
+    const U* data() const { return elems; }
+    U& operator[](size_t i) { return elems[i]; }
+    const U& operator[](size_t i) const { return elems[i]; }
+    U* begin() { return elems; }
+    U* end() { return elems + num; }
+    const U* begin() const { return elems; }
+    const U* end() const { return elems + num; }
+
+    // every resize is a new region, tables only resize on rebuild
+    void resize(size_t new_size, const U& value = U{}) {
+        MappedVector res(file);
+        res.assign_from(elems, std::min(num, new_size), new_size);
+        std::uninitialized_fill(res.elems + std::min(num, new_size),
+                                res.elems + new_size, value);
+        swap(res);
+    }
+    void assign(size_t new_size, const U& value) {
+        MappedVector res(file);
+        res.assign_from(nullptr, 0, new_size);
+        std::uninitialized_fill(res.elems, res.elems + new_size, value);
+        swap(res);
+    }
+    void push_back(const U& value) { resize(num + 1, value); }
+
+    void swap(MappedVector& other) noexcept {
+        std::swap(file, other.file);
+        std::swap(elems, other.elems);
+        std::swap(num, other.num);
+        std::swap(offset, other.offset);
+    }
+    friend void swap(MappedVector& a, MappedVector& b) noexcept { a.swap(b); }
+
+   private:
+    // a fresh region of capacity elements, the first count copied from src
+    void assign_from(const U* src, size_t count, size_t capacity) {
+        release();
+        if (capacity == 0) return;
+        if (!file) {
+            throw std::runtime_error("Mapped table has no file, open it first");
+        }
+        auto [new_offset, addr] = file->allocate(capacity * sizeof(U));
+        offset = new_offset;
+        elems = static_cast<U*>(addr);
+        num = capacity;
+        std::uninitialized_copy_n(src, count, elems);
+    }
+    void assign_from(const U* src, size_t count) {
+        assign_from(src, count, count);
+    }
+    void release() {
+        if (elems) file->release(offset, num * sizeof(U), elems);
+        elems = nullptr;
+        num = 0;
+        offset = 0;
+    }
+
+    std::shared_ptr<MappedFile> file{};
+    uint64_t offset = 0;
+    size_t num = 0;
+    U* elems = nullptr;
+};
+
+// HopscotchHashSet storage in regions of a file, see HopscotchHashSet::open;
+// HeapStorage (memory_policy.h) is the default, this header is only for
+// tables that want a file
+struct MappedStorage {
+    static constexpr bool is_mapped = true;
+    using file_type = MappedFile;
+    template <class U>
+    using array = MappedVector<U>;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Where the storage of a big table comes from. At 10M+ slots lookups spend
+// much of their time on dTLB misses, and on a multi-socket box pages land on
+// the node that touched them first.
+// Allocations under kHugePageSize, and every allocation off Linux, come from
+// operator new whatever the policy says.
+
+// Default -- operator new, whatever pages malloc gets
+// Transparent -- 2MB aligned mmap with madvise(MADV_HUGEPAGE), THP backs it
+// with huge pages when it can
+// HugeTlb -- MAP_HUGETLB from the hugetlbfs pool, Transparent if the pool
+// is empty or not set up
+enum class PageMode { Default, Transparent, HugeTlb };
+
+// Default -- first touch, the thread that fills the table decides
+// Interleave -- pages round-robin over all online nodes
+// Bind -- every page on node, throws if the node isn't online
+enum class NumaMode { Default, Interleave, Bind };
+
+struct MemoryPolicy {
+    PageMode pages = PageMode::Default;
+    NumaMode numa = NumaMode::Default;
+    int node = 0;  // only for NumaMode::Bind
+
+    bool operator==(const MemoryPolicy&) const = default;
+};
+
+namespace memory_detail {
+
+constexpr size_t kHugePageSize = size_t{1} << 21;
+
+inline bool is_mapped(size_t bytes, const MemoryPolicy& policy) {
+#if defined(__linux__)
+    return bytes >= kHugePageSize && (policy.pages != PageMode::Default ||
+                                      policy.numa != NumaMode::Default);
+#else
+    (void)bytes;
+    (void)policy;
+    return false;
+#endif
+}
+
+inline size_t mapped_length(size_t bytes) {
+    return (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+#if defined(__linux__)
+// nodes from /sys/devices/system/node/online, like "0-1,3"; 0 if unknown
+inline uint64_t online_nodes() {
+    std::ifstream in("/sys/devices/system/node/online");
+    std::string list;
+    if (!(in >> list)) return 0;
+    uint64_t mask = 0;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first
+                                             : std::stoi(range.substr(dash + 1));
+        for (int node = first; node <= last && node < 64; ++node) {
+            mask |= uint64_t{1} << node;
+        }
+    }
+    return mask;
+}
+
+// mbind before the first touch, so the pages are faulted where they belong
+inline void place_pages(void* addr, size_t length, const MemoryPolicy& policy) {
+    if (policy.numa == NumaMode::Default) return;
+    // from <numaif.h>, which comes with libnuma
+    constexpr int kMpolBind = 2;
+    constexpr int kMpolInterleave = 3;
+    uint64_t online = online_nodes();
+    unsigned long mask;
+    int mode;
+    if (policy.numa == NumaMode::Bind) {
+        if (policy.node < 0 || policy.node >= 64 ||
+            !((online >> policy.node) & 1)) {
+            throw std::runtime_error("NUMA node " +
+                                     std::to_string(policy.node) +
+                                     " is not online");
+        }
+        mask = static_cast<unsigned long>(uint64_t{1} << policy.node);
+        mode = kMpolBind;
+    } else {
+        // one node, nothing to spread over
+        if ((online & (online - 1)) == 0) return;
+        mask = static_cast<unsigned long>(online);
+        mode = kMpolInterleave;
+    }
+    // a kernel without NUMA support leaves the pages where they fault
+    syscall(SYS_mbind, addr, length, mode, &mask, sizeof(mask) * 8 + 1, 0);
+}
+#endif
+
+inline void* allocate(size_t bytes, size_t alignment,
+                      const MemoryPolicy& policy) {
+    if (!is_mapped(bytes, policy)) {
+        return ::operator new(bytes, std::align_val_t{alignment});
+    }
+#if defined(__linux__)
+    size_t length = mapped_length(bytes);
+    void* addr = MAP_FAILED;
+    if (policy.pages == PageMode::HugeTlb) {
+        addr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (addr == MAP_FAILED) {
+        // THP only backs 2MB aligned ranges, so map one more huge page and
+        // trim both ends to an aligned range of length
+        size_t padded = length + kHugePageSize;
+        void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) throw std::bad_alloc();
+        uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned =
+            (begin + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+        if (aligned > begin) munmap(raw, aligned - begin);
+        size_t tail = begin + padded - (aligned + length);
+        if (tail > 0) munmap(reinterpret_cast<void*>(aligned + length), tail);
+        addr = reinterpret_cast<void*>(aligned);
+        if (policy.pages != PageMode::Default) {
+            madvise(addr, length, MADV_HUGEPAGE);
+        }
+    }
+    try {
+        place_pages(addr, length, policy);
+    } catch (...) {
+        munmap(addr, length);
+        throw;
+    }
+    return addr;
+#else
+    return nullptr;
+#endif
+}
+
+inline void deallocate(void* addr, size_t bytes, size_t alignment,
+                       const MemoryPolicy& policy) {
+    if (!is_mapped(bytes, policy)) {
+        ::operator delete(addr, std::align_val_t{alignment});
+        return;
+    }
+#if defined(__linux__)
+    munmap(addr, mapped_length(bytes));
+#endif
+}
+
+}  // namespace memory_detail
+
+// std allocator that takes its memory as policy says, copies carry the
+// policy along, so a container keeps it through copies, moves and swaps
+template <class T>
+class PolicyAllocator {
+   public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    PolicyAllocator() = default;
+    explicit PolicyAllocator(const MemoryPolicy& init_policy)
+        : policy(init_policy) {}
+    template <class U>
+    PolicyAllocator(const PolicyAllocator<U>& other)
+        : policy(other.memory_policy()) {}
+
+    T* allocate(size_t n) {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(
+            memory_detail::allocate(n * sizeof(T), alignof(T), policy));
+    }
+    void deallocate(T* p, size_t n) {
+        memory_detail::deallocate(p, n * sizeof(T), alignof(T), policy);
+    }
+
+    const MemoryPolicy& memory_policy() const { return policy; }
+
+    template <class U>
+    bool operator==(const PolicyAllocator<U>& other) const {
+        return policy == other.memory_policy();
+    }
+
+   private:
+    MemoryPolicy policy{};
+};
+
+// where HopscotchHashSet keeps values and occupied: std::vector, placed as
+// set_memory_policy says; MappedStorage in mapped_storage.h keeps them in a
+// file
+struct HeapStorage {
+    static constexpr bool is_mapped = false;
+    template <class U>
+    using array = std::vector<U, PolicyAllocator<U>>;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+// hint that addr will be read soon, a no-op where the builtin is missing
+inline void prefetch_read(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr, 0, 3);
+#else
+    (void)addr;
+#endif
+}
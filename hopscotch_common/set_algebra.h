@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bulk intersect / difference / merge for HopscotchShadow and HopscotchHashSet.
+// Every key of one table is probed in the other:
+// - tables of the same layout (is_aligned_with) are walked side by side,
+//   bucket i of one is compared with bucket i of the other
+// - otherwise keys are probed in software-pipelined chunks, the lines a key
+//   needs are requested a few keys before it is looked up
+// The slots of the walked table are split into num_threads ranges, one thread
+// each. Probes record no stats, the result is filled on the calling thread.
+// Table needs: bucket_count, is_aligned_with, for_each_key, probe_aligned,
+// hash_key, prefetch/prefetch_stages, probe_hashed, empty_copy, reserve and
+// insert or add.
+
+namespace set_algebra_detail {
+
+// keys are gathered in chunks, within a chunk the line for stage s of key i
+// is requested while key i - (prefetch_stages - s) * kDistance is probed
+constexpr size_t kChunkSize = 1024;
+constexpr size_t kDistance = 16;
+
+// f(key, other has it) for every key of table in slots [first, last)
+template <class Table, class F>
+void probe_batched(const Table& table, const Table& other,
+                   typename Table::size_type first,
+                   typename Table::size_type last, F& f) {
+    static_assert(Table::prefetch_stages >= 0 && Table::prefetch_stages <= 3,
+                  "probe_batched unrolls at most 3 prefetch stages");
+    using Key = typename Table::key_type;
+    using HashType = decltype(other.hash_key(std::declval<const Key&>()));
+    std::vector<Key> keys{};
+    std::vector<HashType> hashes{};
+    keys.reserve(kChunkSize);
+    hashes.reserve(kChunkSize);
+    auto flush = [&]() {
+        size_t size = keys.size();
+        for (size_t i = 0; i < size; ++i) {
+            // unrolled like in LookupPipeline, a loop over stages or a helper
+            // per stage is 30% slower here
+            constexpr int num_stages = Table::prefetch_stages;
+            if constexpr (num_stages > 2) {
+                size_t ahead = i + (num_stages - 2) * kDistance;
+                if (ahead < size) other.prefetch(hashes[ahead], 2);
+            }
+            if constexpr (num_stages > 1) {
+                size_t ahead = i + (num_stages - 1) * kDistance;
+                if (ahead < size) other.prefetch(hashes[ahead], 1);
+            }
+            if constexpr (num_stages > 0) {
+                size_t ahead = i + num_stages * kDistance;
+                if (ahead < size) other.prefetch(hashes[ahead], 0);
+            }
+            f(keys[i], other.probe_hashed(keys[i], hashes[i]));
+        }
+        keys.clear();
+        hashes.clear();
+    };
+    table.for_each_key(first, last, [&](const Key& key) {
+        keys.push_back(key);
+        hashes.push_back(other.hash_key(key));
+        if (keys.size() == kChunkSize) flush();
+    });
+    flush();
+}
+
+// keys of table that other has (keep_found) or doesn't have (!keep_found)
+template <class Table>
+std::vector<typename Table::key_type> select_keys(const Table& table,
+                                                  const Table& other,
+                                                  bool keep_found,
+                                                  unsigned num_threads) {
+    using Key = typename Table::key_type;
+    using SizeType = typename Table::size_type;
+    SizeType num_slots = table.bucket_count();
+    num_threads = static_cast<unsigned>(std::clamp<uint64_t>(
+        num_threads, 1, std::max<uint64_t>(num_slots, 1)));
+    bool is_aligned = table.is_aligned_with(other);
+    std::vector<std::vector<Key>> parts(num_threads);
+    std::vector<std::exception_ptr> errors(num_threads);
+    auto work = [&](unsigned part) {
+        try {
+            SizeType first = static_cast<uint64_t>(num_slots) * part /
+                             num_threads;
+            SizeType last = static_cast<uint64_t>(num_slots) * (part + 1) /
+                            num_threads;
+            auto keep = [&](const Key& key, bool is_found) {
+                if (is_found == keep_found) parts[part].push_back(key);
+            };
+            if (is_aligned) {
+                table.probe_aligned(other, first, last, keep);
+            } else {
+                probe_batched(table, other, first, last, keep);
+            }
+        } catch (...) {
+            errors[part] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads{};
+    for (unsigned part = 1; part < num_threads; ++part) {
+        threads.emplace_back(work, part);
+    }
+    work(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    std::vector<Key> res{};
+    for (auto& part : parts) {
+        res.insert(res.end(), part.begin(), part.end());
+    }
+    return res;
+}
+
+template <class Table>
+uint64_t num_keys(const Table& table) {
+    if constexpr (requires { table.get_size(); }) {
+        return table.get_size();
+    } else {
+        return table.get_num_elements();
+    }
+}
+
+template <class Table, class Key>
+void insert_all(Table& table, const std::vector<Key>& keys) {
+    table.reserve(static_cast<typename Table::size_type>(num_keys(table) +
+                                                         keys.size()));
+    for (const Key& key : keys) {
+        if constexpr (requires { table.insert(key); }) {
+            table.insert(key);
+        } else {
+            table.add(key);
+        }
+    }
+}
+
+}  // namespace set_algebra_detail
+
+// keys in both tables, the result has the parameters of a
+template <class Table>
+Table intersect(const Table& a, const Table& b, unsigned num_threads = 1) {
+    Table res = a.empty_copy();
+    // walk whichever has fewer slots
+    const Table& walked = b.bucket_count() < a.bucket_count() ? b : a;
+    const Table& probed = &walked == &a ? b : a;
+    set_algebra_detail::insert_all(
+        res, set_algebra_detail::select_keys(walked, probed, true,
+                                             num_threads));
+    return res;
+}
+
+// keys of a that b doesn't have, the result has the parameters of a
+template <class Table>
+Table difference(const Table& a, const Table& b, unsigned num_threads = 1) {
+    Table res = a.empty_copy();
+    set_algebra_detail::insert_all(
+        res, set_algebra_detail::select_keys(a, b, false, num_threads));
+    return res;
+}
+
+// adds every key of from to into, from stays as it is
+template <class Table>
+void merge(Table& into, const Table& from, unsigned num_threads = 1) {
+    set_algebra_detail::insert_all(
+        into, set_algebra_detail::select_keys(from, into, false, num_threads));
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "memory_policy.h"
+
+// The part of google::sparsetable that HopscotchShadow uses, over one flat
+// array of slots and a bitmap of the filled ones. Takes sizeof(T) per slot
+// instead of about 2 bits plus sizeof(T) per key, but a lookup touches one
+// line instead of a group header and then the keys, and the array can be
+// put on huge pages and NUMA nodes (see memory_policy.h).
+template <class T>
+class DenseTable {
+   public:
+    using value_type = T;
+    using size_type = size_t;
+
+    // walks filled slots only, like sparsetable's nonempty iterators
+    template <class Table, class Ref>
+    class nonempty_iterator_base {
+       public:
+        nonempty_iterator_base(Table* init_table, size_type init_ind)
+            : table(init_table), ind(init_ind) {
+            skip_empty();
+        }
+        Ref operator*() const { return table->slots[ind]; }
+        nonempty_iterator_base& operator++() {
+            ++ind;
+            skip_empty();
+            return *this;
+        }
+        bool operator==(const nonempty_iterator_base& other) const {
+            return ind == other.ind;
+        }
+
+       private:
+        void skip_empty() {
+            size_type size = table->size();
+            while (ind < size) {
+                uint64_t bits = table->filled[ind >> 6] >> (ind & 63);
+                if (bits) {
+                    ind += std::countr_zero(bits);
+                    return;
+                }
+                ind = (ind | 63) + 1;
+            }
+            ind = size;
+        }
+
+        Table* table;
+        size_type ind;
+    };
+    using nonempty_iterator = nonempty_iterator_base<DenseTable, T&>;
+    using const_nonempty_iterator =
+        nonempty_iterator_base<const DenseTable, const T&>;
+
+    explicit DenseTable(size_type size = 0,
+                        const MemoryPolicy& policy = MemoryPolicy{})
+        : slots(size, T{}, PolicyAllocator<T>(policy)),
+          filled((size + 63) / 64, 0) {}
+
+    size_type size() const { return slots.size(); }
+    size_type num_nonempty() const { return num_filled; }
+    // keys past the new size are dropped
+    void resize(size_type size) {
+        for (size_type i = size; i < slots.size(); ++i) {
+            if (test(i)) erase(i);
+        }
+        slots.resize(size, T{});
+        filled.resize((size + 63) / 64, 0);
+        if (size & 63) filled.back() &= (uint64_t{1} << (size & 63)) - 1;
+    }
+
+    bool test(size_type i) const { return (filled[i >> 6] >> (i & 63)) & 1; }
+    // T{} for an empty slot
+    const T& get(size_type i) const { return slots[i]; }
+    T& set(size_type i, const T& val) {
+        if (!test(i)) {
+            filled[i >> 6] |= uint64_t{1} << (i & 63);
+            ++num_filled;
+        }
+        slots[i] = val;
+        return slots[i];
+    }
+    void erase(size_type i) {
+        if (!test(i)) return;
+        filled[i >> 6] &= ~(uint64_t{1} << (i & 63));
+        --num_filled;
+        slots[i] = T{};
+    }
+
+    nonempty_iterator nonempty_begin() { return {this, 0}; }
+    nonempty_iterator nonempty_end() { return {this, size()}; }
+    const_nonempty_iterator nonempty_begin() const { return {this, 0}; }
+    const_nonempty_iterator nonempty_end() const { return {this, size()}; }
+
+    MemoryPolicy memory_policy() const {
+        return slots.get_allocator().memory_policy();
+    }
+    // moves the slots to memory taken as policy says
+    void set_memory_policy(const MemoryPolicy& policy) {
+        std::vector<T, PolicyAllocator<T>> moved(slots.begin(), slots.end(),
+                                                 PolicyAllocator<T>(policy));
+        slots.swap(moved);
+    }
+
+    void swap(DenseTable& other) {
+        slots.swap(other.slots);
+        filled.swap(other.filled);
+        std::swap(num_filled, other.num_filled);
+    }
+
+   private:
+    std::vector<T, PolicyAllocator<T>> slots;
+    std::vector<uint64_t> filled;
+    size_type num_filled = 0;
+};
+
+// slot storage of HopscotchShadow, see hopscotch_shadow.h for SparseStorage
+struct DenseStorage {
+    template <class T>
+    using table = DenseTable<T>;
+};
@@ -1,12 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <concepts>
+#include <cstdint>
+#include <exception>
 #include <functional>
 #include <iostream>
 #include <sparsehash/sparsetable>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
+#include <vector>
+
+#include "dense_table.h"
+#include "growth_policy.h"
+#include "hash_mixer.h"
+#include "hopscotch_stats.h"
+#include "prefetch.h"
+#include "sparse_group_table.h"
 
 using std::cout;
 using std::endl;
@@ -37,67 +50,292 @@ std::ostream& operator<<(std::ostream& os, T& val) {
     return (os << &val);
 }*/
 
-template <class Key, class Hash = std::hash<Key>>
+// how far find_elem looks for a key that isn't there
+// Probe -- up to add_range slots, stopping at the first empty one
+// Bounded -- also stops after hop_range slots, inserts never put a key further
+// than that from its home, so a miss costs at most one neighborhood
+enum class LookupMode { Probe, Bounded };
+
+// what erase leaves behind
+// Tombstone -- deleted_key, which lookups step over; needs set_deleted_key
+// BackwardShift -- an empty slot, keys after it move back towards their homes,
+// so probes don't get longer under churn and no key has to be reserved
+enum class EraseMode { Tombstone, BackwardShift };
+
+// key with its full hash, so the table never has to call the hasher on it again
+template <class Key>
+struct HashedSlot {
+    Key key{};
+    size_t hash = 0;
+};
+
+// StoreHash keeps the hash of every key next to it: displacement and rebuilds
+// read it instead of rehashing, and lookups compare it before the key
+// costs a size_t per stored key, worth it for keys that are slow to hash or compare
+// slots live in a google::sparsetable, about 2 bits per empty slot
+struct SparseStorage {
+    template <class T>
+    using table = sparsetable<T>;
+};
+
+// SizeType holds indices and sizes, uint32_t tables stop at 2^31 slots
+// Storage is SparseStorage, DenseStorage (dense_table.h), a flat array that
+// set_memory_policy can put on huge pages and NUMA nodes, or
+// SparseGroupStorage (sparse_group_table.h), sparse with probes walking runs
+// Mixer is applied to every hash before it picks a bucket (hash_mixer.h),
+// for hashers like std::hash<int> that leave patterns in the low bits
+template <class Key, class Hash = std::hash<Key>,
+          class GrowthPolicy = PowerOfTwoGrowthPolicy, bool StoreHash = false,
+          std::unsigned_integral SizeType = uint32_t,
+          class Storage = SparseStorage, class Mixer = NoMixing>
 class HopscotchShadow {
+   public:
+    using slot_type = std::conditional_t<StoreHash, HashedSlot<Key>, Key>;
+    using size_type = SizeType;
+    using growth_policy = GrowthPolicy;
+    using storage_type = typename Storage::template table<slot_type>;
+
    public:  // TODO rollback to private
             //private:
-    // table size MUST be 2^n
-    sparsetable<Key>
-        vals{};  // (64); // some basic init -- can be any power of 2
+    // table size MUST come from GrowthPolicy::round_up
+    storage_type
+        vals{};  // (64); // some basic init -- any size GrowthPolicy allows
     int hop_range = 32;
     int add_range = 128;
     int max_resize_tries =
         2;  // corresponds both to tries in single resize and to resize calls on add TODO maybe fix?
     Hash hasher{};
+    uint64_t hash_seed = 0;  // for Mixer
     Key deleted_key{};
-    int tombstone_count = 0;
+    size_type tombstone_count = 0;
+    float max_load = 1.0f;  // grow before an insert would go above it
+    float min_load = 0.0f;  // shrink once erase goes below it, 0 never shrinks
+    // table size and key count when an erase's shrink last failed, erases
+    // try again once the table was rebuilt or half of those keys are gone
+    uint64_t failed_shrink_buckets = 0;
+    size_type failed_shrink_keys = 0;
+    LookupMode lookup_mode = LookupMode::Probe;
+    EraseMode erase_mode = EraseMode::Tombstone;
+    unsigned resize_threads = 1;
+    [[no_unique_address]] mutable HopscotchCounters<> counters{};
 
    public:
-    HopscotchShadow() { vals = sparsetable<Key>(64); };
+    using key_type = Key;
+
+    HopscotchShadow() {
+        vals = storage_type(GrowthPolicy::round_up(64));
+    };
     HopscotchShadow(int init_hop_range, int init_add_range,
                     int init_max_resize_tries) {
-        vals = sparsetable<Key>(64);
+        vals = storage_type(GrowthPolicy::round_up(64));
         hop_range = init_hop_range;
         add_range = init_add_range;
         max_resize_tries = init_max_resize_tries;
     }
 
     void set_deleted_key(Key key) { deleted_key = key; }
+    // only for an empty table, keys already in it would have other homes
+    void set_hash_seed(uint64_t seed) {
+        if (get_size() > 0)
+            throw std::runtime_error("Hash seed can only be set when empty");
+        hash_seed = seed;
+    }
+    void set_lookup_mode(LookupMode mode) { lookup_mode = mode; }
+    // switching to BackwardShift rebuilds the table to drop its tombstones
+    void set_erase_mode(EraseMode mode);
+    // rebuilds of power-of-two tables that grow are split over n threads,
+    // the hasher is called from all of them; needs a dense copy of the new
+    // table while it runs
+    void set_resize_threads(unsigned n) { resize_threads = std::max(n, 1u); }
+    // pages and NUMA placement of the slots, moves the keys that are there
+    void set_memory_policy(const MemoryPolicy& policy)
+        requires requires(storage_type& table) {
+            table.set_memory_policy(policy);
+        }
+    {
+        vals.set_memory_policy(policy);
+    }
+
+    // doesn't rehash, only for an empty table
+    void set_size(size_type size) {
+        vals.resize(
+            growth_detail::to_size<size_type>(GrowthPolicy::round_up(size)));
+    }
+    size_type table_size() const { return static_cast<size_type>(vals.size()); }
+
+    size_type hash(const Key& key) const {
+        return GrowthPolicy::bucket(hash_of(key), table_size());
+    }
+    // hasher, then Mixer; every full hash in the table is one of these
+    size_t hash_of(const Key& key) const {
+        return static_cast<size_t>(Mixer::mix(hasher(key), hash_seed));
+    }
+
+    static const Key& key_of(const slot_type& slot) {
+        if constexpr (StoreHash) {
+            return slot.key;
+        } else {
+            return slot;
+        }
+    }
+    size_t full_hash_of(const slot_type& slot) const {
+        if constexpr (StoreHash) {
+            return slot.hash;
+        } else {
+            return hash_of(slot);
+        }
+    }
+    static slot_type make_slot(const Key& key,
+                               [[maybe_unused]] size_t full_hash) {
+        if constexpr (StoreHash) {
+            return {key, full_hash};
+        } else {
+            return key;
+        }
+    }
+    // only for filled slots
+    const Key& key_at(size_type ind) const { return key_of(vals.get(ind)); }
+    size_type home_of(size_type ind) const {
+        return GrowthPolicy::bucket(full_hash_of(vals.get(ind)), table_size());
+    }
+    bool is_tombstone(size_type ind) const {
+        return erase_mode == EraseMode::Tombstone && key_at(ind) == deleted_key;
+    }
+    // steps from one slot to another going right, around the end
+    size_type distance(size_type from, size_type to) const {
+        return to >= from ? to - from : to + vals.size() - from;
+    }
 
-    void set_size(uint32_t size) { vals.resize(size); }
+    // wraps an index that went at most one table past the end
+    size_type wrap(uint64_t ind) const {
+        if constexpr (GrowthPolicy::is_power_of_two) {
+            return ind & (vals.size() - 1);
+        } else {
+            return ind < vals.size() ? ind : ind % vals.size();
+        }
+    }
 
-    uint32_t hash(const Key& key) const {
-        return hasher(key) & (vals.size() - 1);
+    // rebuilds with at least n slots, and enough of them for max_load_factor
+    void rehash(size_type n);
+    // makes room for n keys without a resize, as far as neighborhoods allow
+    void reserve(size_type n);
+    float max_load_factor() const { return max_load; }
+    void max_load_factor(float ml) {
+        if (!(ml > 0.0f && ml <= 1.0f))
+            throw std::runtime_error("Max load factor must be in (0, 1]");
+        max_load = ml;
     }
+    float min_load_factor() const { return min_load; }
+    void min_load_factor(float ml) {
+        if (!(ml >= 0.0f && ml < max_load))
+            throw std::runtime_error("Min load factor must be in [0, max)");
+        min_load = ml;
+    }
+    // smallest table that holds the keys at max_load_factor
+    // returns false and keeps the table if nothing smaller could be built
+    bool shrink_to_fit();
 
-    uint32_t find_elem(const Key& key) const;  // returns index of key in vals
+    size_type find_elem(const Key& key, uint32_t* num_probes = nullptr)
+        const;  // returns index of key in vals, num_probes is filled only with HOPSCOTCH_STATS
     bool contains(const Key& key) const;
-    pair<uint32_t, bool> insert(
+
+    // lookup in steps, for pipelines that overlap the cache misses of many keys
+    // (see lookup_pipeline.h): hash, prefetch every stage, then contains_hashed
+    // stage 0 -- group header (none with DenseStorage), stage 1 --
+    // key data, needs the header
+    static constexpr int prefetch_stages = 2;
+    size_t hash_key(const Key& key) const { return hash_of(key); }
+    void prefetch(size_t full_hash, int stage) const;
+    bool contains_hashed(const Key& key, size_t full_hash) const;
+    // contains_hashed without stats, many threads can probe at once
+    bool probe_hashed(const Key& key, size_t full_hash) const {
+        return find_hashed(key, full_hash, nullptr) != vals.size();
+    }
+
+    // for bulk set operations (see set_algebra.h), ranges are of slots
+    size_type bucket_count() const { return vals.size(); }
+    // same size and seed, so with the same (stateless) hasher every key has
+    // the same home bucket in both
+    bool is_aligned_with(const HopscotchShadow& other) const {
+        return vals.size() == other.vals.size() &&
+               hash_seed == other.hash_seed;
+    }
+    // f(key) for every key stored in slots [first, last), tombstones skipped
+    template <class F>
+    void for_each_key(size_type first, size_type last, F&& f) const;
+    // f(key, other has it) for every key stored in slots [first, last)
+    // probes of other walk its slots in the same order, needs is_aligned_with
+    template <class F>
+    void probe_aligned(const HopscotchShadow& other, size_type first,
+                       size_type last, F&& f) const;
+    // no keys, same parameters, deleted key and modes
+    HopscotchShadow empty_copy() const;
+
+    pair<size_type, bool> insert(
         const Key&
             key);  // returns {index of key in vals, true if inserted otherwise false}
-    uint32_t erase(
+    size_type erase(
         const Key& key);  // returns 1 if key was deleted, 0 otherwise
+    // erases every key pred is true for in one pass over the slots, returns
+    // how many; tombstones go too, and keys after each hole move back towards
+    // their homes. With num_threads > 1, pred and the hasher are called from
+    // that many threads at once, each planning the runs of a range of slots
+    template <class Pred>
+    size_type erase_if(Pred pred, unsigned num_threads = 1);
     void print() const;
 
-    uint32_t get_size() const { return vals.num_nonempty() - tombstone_count; }
-    uint32_t get_max_size() const { return vals.size(); }
+    size_type get_size() const { return vals.num_nonempty() - tombstone_count; }
+    size_type get_max_size() const { return vals.size(); }
     float load_factor() const {
         return static_cast<float>(vals.num_nonempty()) /
                static_cast<float>(vals.size());
     }
 
+    HopscotchStats stats() const;  // counters are zero without HOPSCOTCH_STATS
+    void reset_stats() { counters.reset(); }
+
    private:
+    // below this a rebuild stays on one thread
+    static constexpr uint64_t kMinSlotsPerThread = 1 << 14;
+
     void resize();
-    pair<uint32_t, bool> tryinsert(
-        const Key&
-            key);  // returns {index of key in vals, true if inserted otherwise false}
+    bool try_rebuild(uint64_t new_size);  // false if some key didn't fit
+    bool try_shrink(uint64_t new_size);   // false if the table stays as it is
+    void shrink_after_erase();  // try_shrink below min_load, unless it failed
+    // fills new_table on resize_threads threads, false if some key didn't fit
+    bool rebuild_in_regions(HopscotchShadow& new_table) const;
+    // puts slot into the first free staged slot from home on, moving keys
+    // back like tryinsert, all within [home, home + add_range)
+    bool place_staged(std::vector<slot_type>& staged,
+                      std::vector<uint8_t>& is_filled, const slot_type& slot,
+                      uint64_t home) const;
+    pair<size_type, bool> tryinsert(
+        const Key& key,
+        size_t
+            full_hash);  // returns {index of key in vals, true if inserted otherwise false}
+    size_type find_hashed(const Key& key, size_t full_hash,
+                         uint32_t* num_probes) const;
+    void erase_and_shift(size_type ind);  // empties ind, pulls the run back
+    // one step of erase_if: the key in first moves to second, or with
+    // second == vals.size() the slot is emptied
+    using SlotMove = pair<size_type, size_type>;
+    // appends the moves that compact the run of filled slots from start,
+    // returns its length; holes is scratch space
+    template <class Pred>
+    uint64_t plan_run(size_type start, Pred& pred, std::vector<SlotMove>& moves,
+                      std::vector<uint64_t>& holes) const;
+    // returns the number of keys erased, tombstones not counted
+    size_type apply_moves(const std::vector<SlotMove>& moves);
 };
 
-template <class Key, class Hash>
-void HopscotchShadow<Key, Hash>::print() const {
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::print()
+    const {
     cout << "Table: ";
     for (auto it = vals.nonempty_begin(); it != vals.nonempty_end(); ++it) {
-        print(*it);
+        print(key_of(*it));
         //cout << *it;
         cout << " ";
     }
@@ -106,47 +344,298 @@ void HopscotchShadow<Key, Hash>::print() const {
     cout << "Size: " << vals.size() << endl;
 }
 
-template <class Key, class Hash>
-void HopscotchShadow<Key, Hash>::resize() {
-    uint32_t next_size = vals.size();
-    for (int iteration = 0; iteration < max_resize_tries; ++iteration) {
-        next_size *= 2;
-        HopscotchShadow<Key, Hash> new_table(hop_range, add_range,
-                                             max_resize_tries);
-        new_table.set_size(next_size);
-
-        bool flag = true;
-        for (int i = 0; i < static_cast<int>(vals.size());
-             ++i) {  // TODO only check existing elems via nonempty iterator
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+bool HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::try_rebuild(
+    uint64_t new_size) {
+    HopscotchShadow new_table(hop_range, add_range, max_resize_tries);
+    if constexpr (requires { vals.memory_policy(); }) {
+        new_table.vals.set_memory_policy(vals.memory_policy());
+    }
+    new_table.set_size(growth_detail::to_size<size_type>(new_size));
+    // placeholders in the new table must not look like real keys
+    new_table.deleted_key = deleted_key;
+    new_table.erase_mode = erase_mode;
+    new_table.hasher = hasher;
+    new_table.hash_seed = hash_seed;
+
+    bool flag = true;
+    // regions need every new bucket to be an old one plus a multiple of the
+    // old size, and enough slots per thread that few keys are on a boundary
+    bool is_split = GrowthPolicy::is_power_of_two && resize_threads > 1 &&
+                    new_table.vals.size() >= vals.size() &&
+                    vals.size() / resize_threads >= kMinSlotsPerThread &&
+                    vals.size() / resize_threads >
+                        static_cast<uint64_t>(add_range);
+    if (is_split) {
+        flag = rebuild_in_regions(new_table);
+    } else {
+        for (auto it = vals.nonempty_begin(); it != vals.nonempty_end();
+             ++it) {
             // don't insert tombstones!
-            if (vals.test(i) && static_cast<Key>(vals[i]) != deleted_key) {
-                //Key cur_key = vals[i];
-                //flag = new_table.tryinsert(cur_key).second;
-                flag = new_table.tryinsert(vals[i]).second;
-                /*pair<uint32_t, bool> res = new_table.tryinsert(cur_key);
-                flag = res.second;*/
+            if (erase_mode == EraseMode::BackwardShift ||
+                key_of(*it) != deleted_key) {
+                flag =
+                    new_table.tryinsert(key_of(*it), full_hash_of(*it)).second;
                 if (!flag) {
                     break;
                 }
             }
         }
+    }
 
-        if (!flag) {
-            // unsuccessful resize -- try again
-            continue;
+    counters.record_resize_attempt(flag);
+    if (flag) {
+        std::swap(vals, new_table.vals);
+        tombstone_count = 0;
+    }
+    return flag;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+bool HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::rebuild_in_regions(
+    HopscotchShadow& new_table) const {
+    // thread k takes the keys whose old home is in [first, last) of the old
+    // table, in the new one their homes are in copies of that range, one
+    // every old_size slots. A key is placed within add_range of its home, so
+    // threads write disjoint slots of a dense staged table; keys whose home
+    // is closer than that to the end of its copy are put in afterwards
+    uint64_t old_size = vals.size();
+    uint64_t new_size = new_table.vals.size();
+    unsigned num_threads = resize_threads;
+    std::vector<slot_type> staged(new_size);
+    std::vector<uint8_t> is_filled(new_size, 0);
+    std::vector<std::vector<slot_type>> deferred(num_threads);
+    std::vector<uint8_t> is_placed(num_threads, 1);
+    std::vector<std::exception_ptr> errors(num_threads);
+    auto work = [&](unsigned part) {
+        try {
+            uint64_t first = old_size * part / num_threads;
+            uint64_t last = old_size * (part + 1) / num_threads;
+            // keys of the range are stored up to add_range - 1 slots past it
+            for (uint64_t i = first; i < last + add_range; ++i) {
+                size_type ind = wrap(i);
+                if (!vals.test(ind) || is_tombstone(ind)) continue;
+                const slot_type& slot = vals.get(ind);
+                size_t full_hash = full_hash_of(slot);
+                uint64_t old_home = GrowthPolicy::bucket(full_hash, old_size);
+                if (old_home < first || old_home >= last) continue;
+                uint64_t home = GrowthPolicy::bucket(full_hash, new_size);
+                uint64_t end = home - old_home + last;
+                if (home + add_range > end) {
+                    deferred[part].push_back(slot);
+                } else if (!place_staged(staged, is_filled, slot, home)) {
+                    is_placed[part] = 0;
+                    return;
+                }
+            }
+        } catch (...) {
+            errors[part] = std::current_exception();
         }
+    };
+    std::vector<std::thread> threads{};
+    for (unsigned part = 1; part < num_threads; ++part) {
+        threads.emplace_back(work, part);
+    }
+    work(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+    if (std::find(is_placed.begin(), is_placed.end(), 0) != is_placed.end()) {
+        return false;
+    }
 
-        std::swap(vals, new_table.vals);
-        return;
+    // sparsetable counts its keys in one place, so storage is filled by one
+    // thread, in slot order
+    for (uint64_t i = 0; i < new_size; ++i) {
+        if (is_filled[i]) new_table.vals.set(i, staged[i]);
+    }
+    staged = {};
+    is_filled = {};
+    for (const auto& part : deferred) {
+        for (const slot_type& slot : part) {
+            if (!new_table.tryinsert(key_of(slot), full_hash_of(slot)).second) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+bool HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::place_staged(
+    std::vector<slot_type>& staged, std::vector<uint8_t>& is_filled,
+    const slot_type& slot, uint64_t home) const {
+    uint64_t new_size = staged.size();
+    uint64_t free_ind = home;
+    while (is_filled[free_ind]) {
+        ++free_ind;
+        if (free_ind - home == static_cast<uint64_t>(add_range)) return false;
+    }
+    // no wrapping: every key here has its home in the same region, before it
+    while (free_ind - home >= static_cast<uint64_t>(hop_range)) {
+        bool is_moved = false;
+        for (uint64_t ind_to_move_from = free_ind - hop_range + 1;
+             ind_to_move_from < free_ind; ++ind_to_move_from) {
+            uint64_t home_to_move_from = GrowthPolicy::bucket(
+                full_hash_of(staged[ind_to_move_from]), new_size);
+            if (free_ind - home_to_move_from <
+                static_cast<uint64_t>(hop_range)) {
+                staged[free_ind] = staged[ind_to_move_from];
+                is_filled[free_ind] = 1;
+                free_ind = ind_to_move_from;
+                is_moved = true;
+                break;
+            }
+        }
+        if (!is_moved) return false;
+    }
+    staged[free_ind] = slot;
+    is_filled[free_ind] = 1;
+    return true;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::resize() {
+    for (int iteration = 0; iteration < max_resize_tries; ++iteration) {
+        if (try_rebuild(GrowthPolicy::next_size(vals.size(), iteration))) {
+            return;
+        }
+        // unsuccessful resize -- try again
     }
     throw std::runtime_error("Resize was unsuccessful");
 }
 
-template <class Key, class Hash>
-uint32_t HopscotchShadow<Key, Hash>::find_elem(const Key& key) const {
-    uint32_t bucket_ind = hash(key);
-    uint32_t ind_to_check = bucket_ind;
-    for (int num_steps = 0; num_steps < add_range; ++num_steps) {
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::rehash(
+    size_type n) {
+    uint64_t min_size =
+        static_cast<uint64_t>(std::ceil(get_size() / max_load));
+    uint64_t new_size = GrowthPolicy::round_up(std::max<uint64_t>(n, min_size));
+    if (try_rebuild(new_size)) return;
+    // neighborhoods don't fit, grow past the requested size
+    for (int iteration = 0; iteration < max_resize_tries; ++iteration) {
+        if (try_rebuild(GrowthPolicy::next_size(new_size, iteration))) {
+            return;
+        }
+    }
+    throw std::runtime_error("Rehash was unsuccessful");
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+bool HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::try_shrink(
+    uint64_t new_size) {
+    // never below the size of a new table
+    uint64_t size = GrowthPolicy::round_up(
+        std::max(new_size, GrowthPolicy::round_up(64)));
+    // a smaller table has more collisions per neighborhood, so it may not fit
+    // then try sizes between it and the current one
+    for (int iteration = 0; size < vals.size() && iteration <= max_resize_tries;
+         ++iteration) {
+        if (try_rebuild(size)) return true;
+        size = GrowthPolicy::next_size(size, 0);
+    }
+    return false;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::shrink_after_erase() {
+    if (!(get_size() < min_load * vals.size())) return;
+    // a failed try is up to max_resize_tries + 1 rebuilds, don't repeat it
+    // on every erase of the same table
+    if (vals.size() == failed_shrink_buckets &&
+        get_size() > failed_shrink_keys / 2) {
+        return;
+    }
+    // land halfway to max_load, so inserts don't grow it right back
+    if (!try_shrink(static_cast<uint64_t>(
+            std::ceil(get_size() / (max_load / 2))))) {
+        failed_shrink_buckets = vals.size();
+        failed_shrink_keys = get_size();
+    }
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+bool HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::shrink_to_fit() {
+    return try_shrink(static_cast<uint64_t>(std::ceil(get_size() / max_load)));
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::reserve(
+    size_type n) {
+    uint64_t needed = static_cast<uint64_t>(std::ceil(n / max_load));
+    if (needed <= vals.size()) return;
+    rehash(growth_detail::to_size<size_type>(needed));
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+typename HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                         SizeType, Storage, Mixer>::size_type
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                SizeType, Storage, Mixer>::find_elem(
+    const Key& key, uint32_t* num_probes) const {
+    return find_hashed(key, hash_of(key), num_probes);
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+typename HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                         SizeType, Storage, Mixer>::size_type
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                SizeType, Storage, Mixer>::find_hashed(
+    const Key& key, size_t full_hash, uint32_t* num_probes) const {
+    size_type bucket_ind = GrowthPolicy::bucket(full_hash, table_size());
+    size_type ind_to_check = bucket_ind;
+    int max_steps = lookup_mode == LookupMode::Bounded
+                        ? std::min(hop_range, add_range)
+                        : add_range;
+    if constexpr (requires(size_t steps) {
+                      vals.find_in_run(
+                          bucket_ind, 1,
+                          [](const slot_type&) { return true; }, steps);
+                  }) {
+        // the same probe, one group lookup per run of filled slots
+        size_t num_steps = 0;
+        size_type res = static_cast<size_type>(vals.find_in_run(
+            bucket_ind, max_steps,
+            [&](const slot_type& slot) {
+                if constexpr (StoreHash) {
+                    return slot.hash == full_hash && slot.key == key;
+                } else {
+                    return slot == key;
+                }
+            },
+            num_steps));
+        if constexpr (hopscotch_stats_enabled) {
+            if (num_probes) {
+                *num_probes = static_cast<uint32_t>(
+                    res != vals.size() ? num_steps + 1 : num_steps);
+            }
+        }
+        return res;
+    }
+    for (int num_steps = 0; num_steps < max_steps; ++num_steps) {
         if (vals.test(ind_to_check)) {
             // key is real or a tombstone
             /*if (hash(vals[ind_to_check]) == bucket_ind) {
@@ -156,54 +645,373 @@ uint32_t HopscotchShadow<Key, Hash>::find_elem(const Key& key) const {
                     return ind_to_check;
                 }
             }*/
-            if (vals[ind_to_check] == key) {
+            const slot_type& slot = vals.get(ind_to_check);
+            bool is_match;
+            if constexpr (StoreHash) {
+                // cheap reject before comparing keys
+                is_match = slot.hash == full_hash && slot.key == key;
+            } else {
+                is_match = slot == key;
+            }
+            if (is_match) {
+                if constexpr (hopscotch_stats_enabled) {
+                    if (num_probes) *num_probes = num_steps + 1;
+                }
                 return ind_to_check;
             }
-            ++ind_to_check;
-            ind_to_check &= (vals.size() - 1);
+            ind_to_check = wrap(ind_to_check + 1);
             continue;
         }
         // don't check after empty space, but still check after tombstone
+        if constexpr (hopscotch_stats_enabled) {
+            if (num_probes) *num_probes = num_steps;
+        }
         return vals.size();
     }
 
+    if constexpr (hopscotch_stats_enabled) {
+        if (num_probes) *num_probes = max_steps;
+    }
     return vals.size();
 }
 
-template <class Key, class Hash>
-bool HopscotchShadow<Key, Hash>::contains(const Key& key) const {
-    return (find_elem(key) != vals.size());
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+bool HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::contains(
+    const Key& key) const {
+    return contains_hashed(key, hash_of(key));
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+bool HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::contains_hashed(
+    const Key& key, size_t full_hash) const {
+    if constexpr (hopscotch_stats_enabled) {
+        uint32_t num_probes = 0;
+        bool is_found =
+            (find_hashed(key, full_hash, &num_probes) != vals.size());
+        counters.record_lookup(is_found, num_probes);
+        return is_found;
+    }
+    return (find_hashed(key, full_hash, nullptr) != vals.size());
 }
 
-template <class Key, class Hash>
-uint32_t HopscotchShadow<Key, Hash>::erase(const Key& key) {
-    uint32_t elem_ind = find_elem(key);
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::prefetch(
+    size_t full_hash, int stage) const {
+    size_type bucket_ind = GrowthPolicy::bucket(full_hash, table_size());
+    if (stage == 0) {
+        // only the address, the group itself isn't read yet
+        if constexpr (requires { vals.which_group(bucket_ind); }) {
+            prefetch_read(&vals.which_group(bucket_ind));
+        }
+    } else {
+        // reads the group bitmap to find where the key data is packed
+        prefetch_read(&vals.get(bucket_ind));
+    }
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+template <class F>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::for_each_key(size_type first,
+                                             size_type last, F&& f) const {
+    for (size_type i = first; i < last; ++i) {
+        if (vals.test(i) && !is_tombstone(i)) f(key_at(i));
+    }
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+template <class F>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::probe_aligned(
+    const HopscotchShadow& other, size_type first, size_type last,
+    F&& f) const {
+    for (size_type i = first; i < last; ++i) {
+        if (!vals.test(i) || is_tombstone(i)) continue;
+        // its home is within hop_range before i, in other too, so other is
+        // read in slot order as well
+        const slot_type& slot = vals.get(i);
+        f(key_of(slot), other.find_hashed(key_of(slot), full_hash_of(slot),
+                                          nullptr) != other.vals.size());
+    }
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash, SizeType, Storage, Mixer>
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                SizeType, Storage, Mixer>::empty_copy() const {
+    HopscotchShadow res(hop_range, add_range, max_resize_tries);
+    res.hasher = hasher;
+    res.hash_seed = hash_seed;
+    res.deleted_key = deleted_key;
+    res.max_load = max_load;
+    res.min_load = min_load;
+    res.lookup_mode = lookup_mode;
+    res.erase_mode = erase_mode;
+    res.resize_threads = resize_threads;
+    if constexpr (requires { vals.memory_policy(); }) {
+        res.vals.set_memory_policy(vals.memory_policy());
+    }
+    return res;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+HopscotchStats HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                               SizeType, Storage, Mixer>::stats() const {
+    HopscotchStats res;
+    counters.fill(res);
+    res.tombstone_count = tombstone_count;
+    std::vector<uint32_t> keys_per_bucket(vals.size(), 0);
+    for (size_type i = 0; i < vals.size(); ++i) {
+        if (!vals.test(i) || is_tombstone(i)) continue;
+        size_type home = home_of(i);
+        histogram_add(res.home_distances, distance(home, i));
+        ++keys_per_bucket[home];
+    }
+    for (uint32_t num_keys : keys_per_bucket) {
+        histogram_add(res.neighborhood_occupancy, num_keys);
+    }
+    return res;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+typename HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                         SizeType, Storage, Mixer>::size_type
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash, SizeType, Storage,
+                Mixer>::erase(
+    const Key& key) {
+    size_type elem_ind = find_elem(key);
     if (elem_ind == vals.size()) {
         // no key here -- return
         return 0;
     }
-    //vals.erase(elem_ind);
-    vals[elem_ind] = deleted_key;
-    ++tombstone_count;
+    if (erase_mode == EraseMode::BackwardShift) {
+        erase_and_shift(elem_ind);
+    } else {
+        vals.set(elem_ind, make_slot(deleted_key, 0));
+        ++tombstone_count;
+    }
+    shrink_after_erase();
     return 1;
 }
 
-template <class Key, class Hash>
-pair<uint32_t, bool> HopscotchShadow<Key, Hash>::tryinsert(const Key& key) {
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::erase_and_shift(size_type ind) {
+    vals.erase(ind);
+    size_type hole = ind;
+    // the run after the hole ends at the first empty slot, every key in it
+    // whose home is not past the hole moves back into it
+    for (size_type ind_to_check = wrap(hole + 1); vals.test(ind_to_check);
+         ind_to_check = wrap(ind_to_check + 1)) {
+        if (distance(home_of(ind_to_check), ind_to_check) >=
+            distance(hole, ind_to_check)) {
+            slot_type tmp = vals.get(ind_to_check);
+            vals.set(hole, tmp);
+            vals.erase(ind_to_check);
+            hole = ind_to_check;
+        }
+    }
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+template <class Pred>
+typename HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                         SizeType, Storage, Mixer>::size_type
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                SizeType, Storage, Mixer>::erase_if(Pred pred,
+                                                    unsigned num_threads) {
+    uint64_t size = vals.size();
+    if (vals.num_nonempty() == size) {
+        // one run around the whole table, there is no start to walk it from
+        std::vector<Key> keys{};
+        for_each_key(0, table_size(), [&](const Key& key) {
+            if (pred(key)) keys.push_back(key);
+        });
+        for (const Key& key : keys) {
+            erase(key);
+        }
+        return static_cast<size_type>(keys.size());
+    }
+
+    // a run starts at a filled slot after an empty one, every key's home is
+    // in its run, so runs are compacted on their own; a range takes the
+    // runs that start in it, wherever they end. Returns the next slot to
+    // look at, past the empty one after the run
+    auto next_run = [&](uint64_t ind, uint64_t last, auto&& on_run) {
+        if (ind < last && ind > 0 && vals.test(ind - 1)) {
+            // the run through ind started before the range
+            while (ind < last && vals.test(ind)) ++ind;
+        }
+        while (ind < last && !vals.test(ind)) ++ind;
+        if (ind < last) ind += on_run(ind) + 1;
+        return ind;
+    };
+    size_type num_erased = 0;
+    num_threads = static_cast<unsigned>(std::clamp<uint64_t>(
+        num_threads, 1, std::max<uint64_t>(size / kMinSlotsPerThread, 1)));
+    if (num_threads == 1) {
+        // moves of a run are applied before the next one is planned, a pred
+        // that throws leaves every run compacted or untouched
+        std::vector<SlotMove> moves{};
+        std::vector<uint64_t> holes{};
+        uint64_t ind = 0;
+        if (vals.test(size - 1)) {
+            // a run around the end is taken last, from where it starts
+            while (vals.test(ind)) ++ind;
+        }
+        while (ind < size) {
+            ind = next_run(ind, size, [&](uint64_t start) {
+                moves.clear();
+                uint64_t length = plan_run(start, pred, moves, holes);
+                num_erased += apply_moves(moves);
+                return length;
+            });
+        }
+    } else {
+        // storage keeps one count of its keys, so moves are planned on all
+        // threads and applied on this one
+        std::vector<std::vector<SlotMove>> moves(num_threads);
+        std::vector<std::exception_ptr> errors(num_threads);
+        auto work = [&](unsigned part) {
+            try {
+                std::vector<uint64_t> holes{};
+                uint64_t ind = size * part / num_threads;
+                uint64_t last = size * (part + 1) / num_threads;
+                if (part == 0 && vals.test(size - 1)) {
+                    // the run through 0 starts in the last range
+                    while (vals.test(ind)) ++ind;
+                }
+                while (ind < last) {
+                    ind = next_run(ind, last, [&](uint64_t start) {
+                        return plan_run(start, pred, moves[part], holes);
+                    });
+                }
+            } catch (...) {
+                errors[part] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> threads{};
+        for (unsigned part = 1; part < num_threads; ++part) {
+            threads.emplace_back(work, part);
+        }
+        work(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+        for (const auto& part : moves) {
+            num_erased += apply_moves(part);
+        }
+    }
+
+    shrink_after_erase();
+    return num_erased;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+template <class Pred>
+uint64_t HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                         SizeType, Storage, Mixer>::plan_run(
+    size_type start, Pred& pred, std::vector<SlotMove>& moves,
+    std::vector<uint64_t>& holes) const {
+    // a key may move to any slot between its home and itself, so it takes
+    // the first hole at or after its home; every slot it passes on the way
+    // stays filled, since later moves only empty slots further right.
+    // holes are offsets from start, in increasing order
+    holes.clear();
+    uint64_t offset = 0;
+    for (; offset < vals.size(); ++offset) {
+        size_type ind = wrap(start + offset);
+        if (!vals.test(ind)) break;
+        const Key& key = key_of(vals.get(ind));
+        if ((erase_mode == EraseMode::Tombstone && key == deleted_key) ||
+            pred(key)) {
+            moves.push_back({ind, static_cast<size_type>(vals.size())});
+            holes.push_back(offset);
+            continue;
+        }
+        if (holes.empty()) continue;
+        auto hole = std::lower_bound(holes.begin(), holes.end(),
+                                     distance(start, home_of(ind)));
+        if (hole == holes.end()) continue;
+        moves.push_back({ind, wrap(start + *hole)});
+        holes.erase(hole);
+        holes.push_back(offset);
+    }
+    return offset;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+typename HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                         SizeType, Storage, Mixer>::size_type
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                SizeType, Storage, Mixer>::apply_moves(
+    const std::vector<SlotMove>& moves) {
+    size_type num_erased = 0;
+    for (auto [from, to] : moves) {
+        if (to == vals.size()) {
+            if (is_tombstone(from)) {
+                --tombstone_count;
+            } else {
+                ++num_erased;
+            }
+        } else {
+            // a copy, set can move the slots of a sparse group around
+            slot_type tmp = vals.get(from);
+            vals.set(to, tmp);
+        }
+        vals.erase(from);
+    }
+    return num_erased;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+void HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                     SizeType, Storage, Mixer>::set_erase_mode(EraseMode mode) {
+    if (mode == EraseMode::BackwardShift && tombstone_count > 0) {
+        rehash(vals.size());
+    }
+    erase_mode = mode;
+}
+
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+pair<typename HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                              SizeType, Storage, Mixer>::size_type, bool>
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                SizeType, Storage, Mixer>::tryinsert(
+    const Key& key, size_t full_hash) {
     // firstly check if contains
-    uint32_t position_of_this = find_elem(key);
+    size_type position_of_this = find_hashed(key, full_hash, nullptr);
     if (position_of_this != vals.size()) {
         return {position_of_this, false};
     }
     // if not contains -- insert normally
 
     // find first empty cell
-    uint32_t bucket_ind = hash(key);
-    uint32_t ind_to_check = bucket_ind;
+    size_type bucket_ind = GrowthPolicy::bucket(full_hash, table_size());
+    size_type ind_to_check = bucket_ind;
     int right_shift;
     for (right_shift = 0; right_shift < add_range; ++right_shift) {
-        if (!vals.test(ind_to_check) ||
-            static_cast<Key>(vals[ind_to_check]) == deleted_key) {
+        if (!vals.test(ind_to_check) || is_tombstone(ind_to_check)) {
             // found free cell or a tombstone
             break;
         }
@@ -213,8 +1021,7 @@ pair<uint32_t, bool> HopscotchShadow<Key, Hash>::tryinsert(const Key& key) {
             break;
         }*/
 
-        ++ind_to_check;
-        ind_to_check &= (vals.size() - 1);
+        ind_to_check = wrap(ind_to_check + 1);
     }
 
     if (right_shift == add_range) {
@@ -230,17 +1037,27 @@ pair<uint32_t, bool> HopscotchShadow<Key, Hash>::tryinsert(const Key& key) {
     } else {
         vals[ind_to_check] = Key{};
     }*/
-    vals[ind_to_check] = deleted_key;
+    // the hole travels left while keys move right, it holds a placeholder:
+    // a tombstone, or without tombstones the new key itself, which is
+    // erased again if the hole can't be brought into range
+    if (vals.test(ind_to_check)) {
+        // reusing a tombstone
+        --tombstone_count;
+    }
+    const slot_type placeholder = erase_mode == EraseMode::Tombstone
+                                      ? make_slot(deleted_key, 0)
+                                      : make_slot(key, full_hash);
+    vals.set(ind_to_check, placeholder);
 
     // if we have to move elements -- move them
+    uint32_t num_moves = 0;
     while (right_shift >= hop_range) {
         bool is_moved = false;
         // check if we can move element into this cell from left to right
         for (int shift_to_move = right_shift - hop_range + 1;
              shift_to_move < right_shift; ++shift_to_move) {
-            uint32_t ind_to_move_from =
-                (bucket_ind + shift_to_move) & (vals.size() - 1);
-            uint32_t bucket_to_move_from = hash(vals[ind_to_move_from]);
+            size_type ind_to_move_from = wrap(bucket_ind + shift_to_move);
+            size_type bucket_to_move_from = home_of(ind_to_move_from);
             // check if ind_to_check is in range of bucket_to_move_from
             if ((ind_to_check >= bucket_to_move_from &&
                  ind_to_check - bucket_to_move_from <
@@ -248,12 +1065,12 @@ pair<uint32_t, bool> HopscotchShadow<Key, Hash>::tryinsert(const Key& key) {
                 (ind_to_check < bucket_to_move_from &&
                  ind_to_check + vals.size() - bucket_to_move_from <
                      static_cast<uint32_t>(hop_range))) {
-                uint32_t cur_size = vals.num_nonempty();
+                size_type cur_size = vals.num_nonempty();
                 assert(vals.test(ind_to_check));
                 assert(vals.test(ind_to_move_from));
                 // move filled cell
-                Key tmp = vals[ind_to_move_from];
-                vals[ind_to_check] = tmp;
+                slot_type tmp = vals.get(ind_to_move_from);
+                vals.set(ind_to_check, tmp);
                 /*if (cur_size + 1 != vals.num_nonempty()) {
                     cout << "Ind to check: " << ind_to_check << endl;
                     cout << "Bucket to move from: " << bucket_to_move_from << endl;
@@ -274,12 +1091,13 @@ pair<uint32_t, bool> HopscotchShadow<Key, Hash>::tryinsert(const Key& key) {
                 } else {
                     vals[ind_to_move_from] = Key{};
                 }*/
-                vals[ind_to_move_from] = deleted_key;
+                vals.set(ind_to_move_from, placeholder);
 
                 ind_to_check = ind_to_move_from;
                 right_shift = shift_to_move;
                 is_moved = true;
-                uint32_t size_now = vals.num_nonempty();
+                ++num_moves;
+                size_type size_now = vals.num_nonempty();
                 assert(cur_size == size_now);
                 /*if (cur_size != size_now) {
                     cout << "Cur size: " << cur_size << endl;
@@ -292,23 +1110,43 @@ pair<uint32_t, bool> HopscotchShadow<Key, Hash>::tryinsert(const Key& key) {
 
         if (!is_moved) {
             // can't move and are out of range
-            // preserve tombstone, return
-            //vals.erase(ind_to_check);
+            if (erase_mode == EraseMode::BackwardShift) {
+                erase_and_shift(ind_to_check);
+            } else {
+                // preserve tombstone, return
+                ++tombstone_count;
+            }
             return {vals.size(), false};
         }
     }
 
     // now we are in range
-    uint32_t cur_size = vals.num_nonempty();
-    vals[ind_to_check] = key;
-    uint32_t size_now = vals.num_nonempty();
+    size_type cur_size = vals.num_nonempty();
+    vals.set(ind_to_check, make_slot(key, full_hash));
+    size_type size_now = vals.num_nonempty();
     assert(cur_size == size_now);
+    counters.record_insert(num_moves);
     return {ind_to_check, true};
 }
 
-template <class Key, class Hash>
-pair<uint32_t, bool> HopscotchShadow<Key, Hash>::insert(const Key& key) {
-    pair<uint32_t, bool> res = tryinsert(key);
+template <class Key, class Hash, class GrowthPolicy, bool StoreHash,
+          std::unsigned_integral SizeType, class Storage, class Mixer>
+pair<typename HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash,
+                              SizeType, Storage, Mixer>::size_type, bool>
+HopscotchShadow<Key, Hash, GrowthPolicy, StoreHash, SizeType, Storage,
+                Mixer>::insert(
+    const Key& key) {
+    // hash once, every try below reuses it
+    size_t full_hash = hash_of(key);
+    if (vals.num_nonempty() + 1 > max_load * vals.size()) {
+        // grow early, but not for a key that is already here
+        size_type position_of_this = find_hashed(key, full_hash, nullptr);
+        if (position_of_this != vals.size()) {
+            return {position_of_this, false};
+        }
+        resize();
+    }
+    pair<size_type, bool> res = tryinsert(key, full_hash);
     if (res.first != vals.size()) {
         // insert was successful or key already existed
         return res;
@@ -318,7 +1156,7 @@ pair<uint32_t, bool> HopscotchShadow<Key, Hash>::insert(const Key& key) {
     int iter_count = 0;
     while (iter_count < max_resize_tries) {
         resize();
-        pair<uint32_t, bool> res_now = tryinsert(key);
+        pair<size_type, bool> res_now = tryinsert(key, full_hash);
         if (res_now.second) {
             // we know here is no key
             return res_now;
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hopscotch_shadow.h"
+
+// HopscotchShadow for one writer and many reader threads, readers never
+// block and never see a table in the middle of an insert or a resize.
+//
+// A table can't be read while it's written, sparsetable moves its groups and
+// inserts move keys, so there are two copies. Readers go through an atomic
+// pointer to the published one, the writer changes the other. publish()
+// switches the pointer, waits until every reader that may still hold the old
+// pointer has left its epoch, then replays the writes on the old copy. A
+// resize happens on the copy nobody reads, and its old slots are freed only
+// after that wait.
+// Costs two tables and every write twice; the writer waits for readers,
+// readers only do two atomic increments per read.
+// Table is a HopscotchShadow, readers use probe_hashed (no stats).
+template <class Table>
+class SnapshotShadow {
+   public:
+    using key_type = typename Table::key_type;
+
+   private:
+    // odd while its reader is inside read, one per line so readers don't
+    // share a line with each other
+    struct alignas(64) ReaderEpoch {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> is_used{false};
+    };
+
+   public:
+    // one per reader thread, registered until destroyed; must not outlive
+    // the SnapshotShadow it came from
+    class Reader {
+       public:
+        Reader(Reader&& other) noexcept
+            : owner(std::exchange(other.owner, nullptr)),
+              slot(std::exchange(other.slot, nullptr)) {}
+        Reader& operator=(Reader other) noexcept {
+            std::swap(owner, other.owner);
+            std::swap(slot, other.slot);
+            return *this;
+        }
+        ~Reader() {
+            if (slot) slot->is_used.store(false, std::memory_order_release);
+        }
+
+        // f(const Table&) on the published table, which stays the same and
+        // alive until f returns
+        template <class F>
+        decltype(auto) read(F&& f);
+        bool contains(const key_type& key) {
+            return read([&](const Table& table) {
+                return table.probe_hashed(key, table.hash_key(key));
+            });
+        }
+
+       private:
+        friend class SnapshotShadow;
+        Reader(const SnapshotShadow* init_owner, ReaderEpoch* init_slot)
+            : owner(init_owner), slot(init_slot) {}
+
+        const SnapshotShadow* owner;
+        ReaderEpoch* slot;
+    };
+
+    // both copies start as init, so deleted key, modes and size carry over
+    explicit SnapshotShadow(const Table& init = Table{});
+    SnapshotShadow(const SnapshotShadow&) = delete;
+    SnapshotShadow& operator=(const SnapshotShadow&) = delete;
+
+    // takes a lock, not for the read path
+    Reader make_reader() const;
+
+    // writer only; readers see these after the next publish
+    bool insert(const key_type& key);
+    bool erase(const key_type& key);
+    // the table readers see, also writer only
+    const Table& published() const { return tables[1 - writable]; }
+    size_t num_unpublished() const { return pending.size(); }
+
+    // readers see every write made so far
+    void publish();
+
+   private:
+    struct PendingWrite {
+        key_type key;
+        bool is_insert;
+    };
+
+    // returns once no reader is in an epoch that began before it was called
+    void wait_for_readers() const;
+
+    Table tables[2];
+    int writable = 0;
+    std::atomic<const Table*> current;
+    std::vector<PendingWrite> pending{};
+    // slots are never freed, so reader pointers stay valid
+    mutable std::vector<std::unique_ptr<ReaderEpoch>> epochs{};
+    mutable std::mutex epochs_mutex{};
+};
+
+template <class Table>
+template <class F>
+decltype(auto) SnapshotShadow<Table>::Reader::read(F&& f) {
+    // seq_cst: either the writer sees this epoch as odd, or this load sees
+    // the pointer the writer stored before looking
+    slot->epoch.fetch_add(1);
+    struct Leave {
+        ReaderEpoch* slot;
+        ~Leave() { slot->epoch.fetch_add(1, std::memory_order_release); }
+    } leave{slot};
+    return f(*owner->current.load());
+}
+
+template <class Table>
+SnapshotShadow<Table>::SnapshotShadow(const Table& init)
+    : tables{init, init}, current(&tables[1]) {}
+
+template <class Table>
+typename SnapshotShadow<Table>::Reader SnapshotShadow<Table>::make_reader()
+    const {
+    std::lock_guard<std::mutex> lock(epochs_mutex);
+    for (auto& slot : epochs) {
+        bool is_used = false;
+        if (slot->is_used.compare_exchange_strong(is_used, true)) {
+            return Reader(this, slot.get());
+        }
+    }
+    epochs.push_back(std::make_unique<ReaderEpoch>());
+    epochs.back()->is_used.store(true);
+    return Reader(this, epochs.back().get());
+}
+
+template <class Table>
+bool SnapshotShadow<Table>::insert(const key_type& key) {
+    bool is_inserted = tables[writable].insert(key).second;
+    if (is_inserted) pending.push_back({key, true});
+    return is_inserted;
+}
+
+template <class Table>
+bool SnapshotShadow<Table>::erase(const key_type& key) {
+    bool is_erased = tables[writable].erase(key) == 1;
+    if (is_erased) pending.push_back({key, false});
+    return is_erased;
+}
+
+template <class Table>
+void SnapshotShadow<Table>::publish() {
+    if (pending.empty()) return;
+    current.store(&tables[writable]);
+    wait_for_readers();
+    // nobody reads the old copy now, bring it up to date
+    writable = 1 - writable;
+    Table& table = tables[writable];
+    for (const PendingWrite& write : pending) {
+        if (write.is_insert) {
+            table.insert(write.key);
+        } else {
+            table.erase(write.key);
+        }
+    }
+    pending.clear();
+}
+
+template <class Table>
+void SnapshotShadow<Table>::wait_for_readers() const {
+    std::vector<std::pair<const ReaderEpoch*, uint64_t>> seen{};
+    {
+        // readers registered after this already see the new pointer
+        std::lock_guard<std::mutex> lock(epochs_mutex);
+        for (const auto& slot : epochs) {
+            uint64_t epoch = slot->epoch.load();
+            if (epoch & 1) seen.emplace_back(slot.get(), epoch);
+        }
+    }
+    // a reader that moved on has left the epoch it was in, whatever it
+    // entered after
+    for (const auto& [slot, epoch] : seen) {
+        while (slot->epoch.load(std::memory_order_acquire) == epoch) {
+            std::this_thread::yield();
+        }
+    }
+}
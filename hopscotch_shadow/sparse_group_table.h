@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// filled slots of bitmap below bit; with -mbmi2 -mpopcnt (HOPSCOTCH_BMI2 in
+// CMake) one bzhi and one popcnt
+inline unsigned rank_below(uint64_t bitmap, unsigned bit) {
+#ifdef __BMI2__
+    return static_cast<unsigned>(std::popcount(_bzhi_u64(bitmap, bit)));
+#else
+    return static_cast<unsigned>(
+        std::popcount(bitmap & ((uint64_t{1} << bit) - 1)));
+#endif
+}
+
+// The part of google::sparsetable that HopscotchShadow uses, in groups of 64
+// slots: a bitmap word, and the filled slots packed in slot order in an array
+// with some spare room. Compared to sparsetable:
+// - a slot's rank in its group is one popcount of one word, no multi-word
+//   bitmap and no per-group slot count to keep up
+// - the array grows by half its size, not by one slot, so inserts into a
+//   group reallocate about 10 times on the way to 64 keys instead of 64;
+//   it shrinks to twice the keys when only a quarter of it is used
+// - find_in_run walks consecutive filled slots, which hopscotch probes
+//   are, with one group lookup and one rank per group instead of per slot
+// A group header is 24 bytes, 3 bits per slot, plus the spare room.
+template <class T>
+class SparseGroupTable {
+   public:
+    using value_type = T;
+    using size_type = size_t;
+
+    struct Group {
+        std::unique_ptr<T[]> items{};  // popcount(bitmap) of capacity in use
+        uint64_t bitmap = 0;
+        uint32_t capacity = 0;
+
+        Group() = default;
+        Group(const Group& other)
+            : items(other.capacity ? new T[other.capacity] : nullptr),
+              bitmap(other.bitmap),
+              capacity(other.capacity) {
+            std::copy_n(other.items.get(), std::popcount(bitmap), items.get());
+        }
+        Group& operator=(const Group& other) {
+            Group copy(other);
+            std::swap(*this, copy);
+            return *this;
+        }
+        Group(Group&&) noexcept = default;
+        Group& operator=(Group&&) noexcept = default;
+
+        unsigned num_items() const { return std::popcount(bitmap); }
+        // items[] position of slot bit, filled or not
+        unsigned rank(unsigned bit) const { return rank_below(bitmap, bit); }
+        // moves the items to an array of new_capacity
+        void reallocate(uint32_t new_capacity);
+    };
+
+    // walks filled slots only, like sparsetable's nonempty iterators
+    template <class Table, class Ref>
+    class nonempty_iterator_base {
+       public:
+        nonempty_iterator_base(Table* init_table, size_type init_ind)
+            : table(init_table), ind(init_ind) {
+            skip_empty();
+        }
+        Ref operator*() const {
+            const auto& group = table->groups[ind >> 6];
+            return group.items[group.rank(ind & 63)];
+        }
+        nonempty_iterator_base& operator++() {
+            ++ind;
+            skip_empty();
+            return *this;
+        }
+        bool operator==(const nonempty_iterator_base& other) const {
+            return ind == other.ind;
+        }
+
+       private:
+        void skip_empty() {
+            size_type size = table->size();
+            while (ind < size) {
+                uint64_t bits = table->groups[ind >> 6].bitmap >> (ind & 63);
+                if (bits) {
+                    ind += std::countr_zero(bits);
+                    return;
+                }
+                ind = (ind | 63) + 1;
+            }
+            ind = size;
+        }
+
+        Table* table;
+        size_type ind;
+    };
+    using nonempty_iterator = nonempty_iterator_base<SparseGroupTable, T&>;
+    using const_nonempty_iterator =
+        nonempty_iterator_base<const SparseGroupTable, const T&>;
+
+    explicit SparseGroupTable(size_type size = 0)
+        : groups((size + 63) / 64), num_slots(size) {}
+
+    size_type size() const { return num_slots; }
+    size_type num_nonempty() const { return num_filled; }
+    // keys past the new size are dropped
+    void resize(size_type size);
+
+    bool test(size_type i) const {
+        return (groups[i >> 6].bitmap >> (i & 63)) & 1;
+    }
+    // T{} for an empty slot
+    const T& get(size_type i) const {
+        const Group& group = groups[i >> 6];
+        unsigned bit = i & 63;
+        if (!((group.bitmap >> bit) & 1)) return empty_value;
+        return group.items[group.rank(bit)];
+    }
+    T& set(size_type i, const T& val);
+    void erase(size_type i);
+
+    // for prefetches, the header holds the bitmap and where the items are
+    const Group& which_group(size_type i) const { return groups[i >> 6]; }
+    // index of the first slot of the filled run from first on (around the
+    // end) that matches, size() once the run ends or after max_steps slots;
+    // steps is the number of slots looked at before the one returned
+    template <class Pred>
+    size_type find_in_run(size_type first, size_type max_steps, Pred&& matches,
+                          size_type& steps) const;
+
+    nonempty_iterator nonempty_begin() { return {this, 0}; }
+    nonempty_iterator nonempty_end() { return {this, size()}; }
+    const_nonempty_iterator nonempty_begin() const { return {this, 0}; }
+    const_nonempty_iterator nonempty_end() const { return {this, size()}; }
+
+    // bytes of group headers and item arrays, spare room included
+    size_t memory_usage() const;
+
+    void swap(SparseGroupTable& other) {
+        groups.swap(other.groups);
+        std::swap(num_slots, other.num_slots);
+        std::swap(num_filled, other.num_filled);
+    }
+
+   private:
+    static inline const T empty_value{};
+
+    std::vector<Group> groups;
+    size_type num_slots = 0;
+    size_type num_filled = 0;
+};
+
+template <class T>
+void SparseGroupTable<T>::Group::reallocate(uint32_t new_capacity) {
+    capacity = new_capacity;
+    if (new_capacity == 0) {
+        items.reset();
+        return;
+    }
+    std::unique_ptr<T[]> moved(new T[new_capacity]);
+    if (items) std::move(items.get(), items.get() + num_items(), moved.get());
+    items = std::move(moved);
+}
+
+template <class T>
+void SparseGroupTable<T>::resize(size_type size) {
+    for (size_type i = size; i < num_slots; ++i) {
+        if (test(i)) erase(i);
+    }
+    groups.resize((size + 63) / 64);
+    num_slots = size;
+}
+
+template <class T>
+T& SparseGroupTable<T>::set(size_type i, const T& val) {
+    Group& group = groups[i >> 6];
+    unsigned bit = i & 63;
+    unsigned pos = group.rank(bit);
+    if ((group.bitmap >> bit) & 1) {
+        group.items[pos] = val;
+        return group.items[pos];
+    }
+    unsigned num_items = group.num_items();
+    if (num_items == group.capacity) {
+        group.reallocate(std::min<uint32_t>(
+            64, group.capacity + std::max<uint32_t>(2, group.capacity / 2)));
+    }
+    T* items = group.items.get();
+    std::move_backward(items + pos, items + num_items, items + num_items + 1);
+    items[pos] = val;
+    group.bitmap |= uint64_t{1} << bit;
+    ++num_filled;
+    return items[pos];
+}
+
+template <class T>
+void SparseGroupTable<T>::erase(size_type i) {
+    Group& group = groups[i >> 6];
+    unsigned bit = i & 63;
+    if (!((group.bitmap >> bit) & 1)) return;
+    unsigned pos = group.rank(bit);
+    unsigned num_items = group.num_items();
+    T* items = group.items.get();
+    std::move(items + pos + 1, items + num_items, items + pos);
+    items[num_items - 1] = T{};
+    group.bitmap &= ~(uint64_t{1} << bit);
+    --num_filled;
+    --num_items;
+    if (num_items == 0) {
+        group.reallocate(0);
+    } else if (num_items * 4 <= group.capacity) {
+        group.reallocate(num_items * 2);
+    }
+}
+
+template <class T>
+template <class Pred>
+typename SparseGroupTable<T>::size_type SparseGroupTable<T>::find_in_run(
+    size_type first, size_type max_steps, Pred&& matches,
+    size_type& steps) const {
+    size_type ind = first;
+    steps = 0;
+    while (steps < max_steps) {
+        const Group& group = groups[ind >> 6];
+        unsigned bit = ind & 63;
+        // bits above the last slot are never set, so a run stops at the end
+        size_type run = std::countr_one(group.bitmap >> bit);
+        size_type num_to_check = std::min(run, max_steps - steps);
+        const T* item = group.items.get() + group.rank(bit);
+        for (size_type k = 0; k < num_to_check; ++k) {
+            if (matches(item[k])) return ind + k;
+            ++steps;
+        }
+        if (num_to_check < run) break;
+        ind += run;
+        if (ind == num_slots) {
+            ind = 0;
+        } else if (bit + run < 64) {
+            break;  // an empty slot
+        }
+    }
+    return num_slots;
+}
+
+template <class T>
+size_t SparseGroupTable<T>::memory_usage() const {
+    size_t res = groups.capacity() * sizeof(Group);
+    for (const Group& group : groups) res += group.capacity * sizeof(T);
+    return res;
+}
+
+// slot storage of HopscotchShadow, see hopscotch_shadow.h for SparseStorage
+struct SparseGroupStorage {
+    template <class T>
+    using table = SparseGroupTable<T>;
+};
@@ -1,22 +1,116 @@
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
 
+#include "bench_results.h"
 #include "benches.h"
 #include "hopscotch_shadow.h"
 
 using std::cout;
 using std::endl;
+using std::string;
+
+// optional bench suites, without any of them bench_everything is run
+const std::map<string, std::function<void()>> suites{
+    {"--cache-sweep", bench_cache_sweep},
+    {"--key-families", bench_key_families},
+    {"--hop-ranges", bench_hop_ranges},
+    {"--high-load-inserts", bench_high_load_inserts},
+    {"--reserve", bench_reserve},
+    {"--bounded-lookup", bench_bounded_lookup},
+    {"--churn", bench_churn},
+    {"--lookup-pipeline", bench_lookup_pipeline},
+    {"--counting", bench_counting},
+    {"--set-algebra", bench_set_algebra},
+    {"--large-table", bench_large_table},
+    {"--parallel-resize", bench_parallel_resize},
+    {"--mapped", bench_mapped},
+    {"--snapshot-readers", bench_snapshot_readers},
+    {"--insert-buffers", bench_insert_buffers},
+    {"--dedup", bench_dedup},
+    {"--adversarial-keys", bench_adversarial_keys},
+    {"--sparse-groups", bench_sparse_groups},
+    {"--erase-if", bench_erase_if},
+};
+
+void print_usage() {
+    cout << "Usage:\n"
+         << "  bench [--seed N] [--format text|json|csv] [--output FILE]\n"
+         << "        [--repetitions N] [--data-dir DIR] [--dataset-cache DIR]\n"
+         << "        [SUITE]\n"
+         << "  bench --compare BASELINE CANDIDATE [--min-slowdown FRACTION]\n"
+         << "Compare mode exits with 1 if candidate has significant regressions.\n"
+         << "Suites:";
+    for (const auto& [name, suite] : suites) {
+        cout << " " << name;
+    }
+    cout << endl;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig& config = bench_config();
+    string baseline_path{};
+    string candidate_path{};
+    double min_slowdown = 0.0;
+    std::function<void()> suite = bench_everything;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--seed" && has_value) {
+            config.seed = std::stoull(argv[++i]);
+        } else if (arg == "--format" && has_value) {
+            string format = argv[++i];
+            if (format == "text") {
+                config.format = OutputFormat::Text;
+            } else if (format == "json") {
+                config.format = OutputFormat::Json;
+            } else if (format == "csv") {
+                config.format = OutputFormat::Csv;
+            } else {
+                print_usage();
+                return 2;
+            }
+        } else if (arg == "--output" && has_value) {
+            config.output_path = argv[++i];
+        } else if (arg == "--repetitions" && has_value) {
+            config.repetitions = std::stoi(argv[++i]);
+        } else if (arg == "--data-dir" && has_value) {
+            config.data_dir = argv[++i];
+        } else if (arg == "--dataset-cache" && has_value) {
+            config.dataset_cache = argv[++i];
+        } else if (arg == "--compare" && i + 2 < argc) {
+            baseline_path = argv[++i];
+            candidate_path = argv[++i];
+        } else if (suites.contains(arg)) {
+            suite = suites.at(arg);
+        } else if (arg == "--min-slowdown" && has_value) {
+            min_slowdown = std::stod(argv[++i]);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+
+    if (!baseline_path.empty()) {
+        return compare_results(baseline_path, candidate_path, min_slowdown) > 0
+                   ? 1
+                   : 0;
+    }
 
-int main() {
     //bench_single_size_and_op(1000000, OpType::Insert);
     //bench_single_size_and_op(1000000, OpType::Remove);
     //bench_single_size_and_op(1000000, OpType::TrueContains);
     //bench_single_size_and_op(1000000, OpType::TrueContains);
     //bench_single_size(1000000);
-    bench_everything();
+    suite();
+    write_results();
     /*print<int>(1);
     cout << endl;*/
     /*print<vector<int>>({1});
     cout << endl;*/
     /*HopscotchShadow<int, std::hash<int>> table{};
     table.print();*/
-}
\ No newline at end of file
+}
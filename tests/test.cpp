@@ -1,12 +1,30 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
 #include <random>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "dedup.h"
 #include "hopscotch_bitmaps.h"
+#include "hopscotch_counting.h"
 #include "hopscotch_shadow.h"
+#include "insert_buffers.h"
+#include "lookup_pipeline.h"
+#include "mapped_storage.h"
+#include "set_algebra.h"
+#include "snapshot_shadow.h"
 
 using std::vector;
 
+#include <catch2/catch_template_test_macros.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 TEST_CASE("Simple insert") {
@@ -200,6 +218,1274 @@ TEST_CASE("Big Bitmaps") {
     }
 }
 
+TEST_CASE("Bitmaps rebuilds are deterministic") {
+    // reseeds come from the seed and the try, the same inserts give the same
+    // slots, so bench runs with one --seed do the same work
+    auto layout = [] {
+        HopscotchHashSet<int> table{};
+        for (int i = 0; i < 100'000; ++i) {
+            table.add(static_cast<int>(static_cast<uint32_t>(i) * 2654435761u));
+        }
+        vector<int> res{};
+        table.for_each_key(0, table.bucket_count(),
+                           [&](int key) { res.push_back(key); });
+        return std::pair(table.bucket_count(), res);
+    };
+    auto first = layout();
+    REQUIRE(first.second.size() == 100'000);
+    REQUIRE(layout() == first);
+}
+
+TEMPLATE_TEST_CASE_SIG("Bitmaps neighborhood widths", "", ((uint32_t W), W),
+                       8, 16, 32, 64) {
+    HopscotchHashSet<int, W> table{};
+    STATIC_REQUIRE(sizeof(typename HopscotchHashSet<int, W>::bitmap_type) * 8 ==
+                   W);
+    for (int i = 1; i <= 10'000; ++i) {
+        table.add(i);
+    }
+    REQUIRE(table.get_num_elements() == 10'000);
+    for (int i = 1; i <= 10'000; ++i) {
+        REQUIRE(table.contains(i));
+        REQUIRE_FALSE(table.contains(-i));
+    }
+    for (int i = 1; i <= 10'000; i += 2) {
+        table.remove(i);
+    }
+    REQUIRE(table.get_num_elements() == 5'000);
+    for (int i = 1; i <= 10'000; ++i) {
+        REQUIRE(table.contains(i) == (i % 2 == 0));
+    }
+}
+
+TEST_CASE("Bitmaps default value key") {
+    // 0 == int{} used to need special handling of its bucket
+    HopscotchHashSet<int> table{};
+    REQUIRE_FALSE(table.contains(0));
+    table.add(0);
+    REQUIRE(table.contains(0));
+    for (int i = 1; i < 10'000; ++i) {
+        table.add(i);
+        table.add(-i);
+    }
+    REQUIRE(table.get_num_elements() == 19'999);
+    REQUIRE(table.contains(0));
+    table.remove(0);
+    REQUIRE_FALSE(table.contains(0));
+    REQUIRE_THROWS(table.remove(0));
+    for (int i = 1; i < 10'000; ++i) {
+        REQUIRE(table.contains(i));
+        REQUIRE(table.contains(-i));
+    }
+
+    HopscotchHashSet<int, 8> full_table{};
+    full_table.init(64, default_seed);
+    full_table.allow_resize(false);
+    int num_added = 0;
+    try {
+        for (int i = 0; i < 64; ++i) {
+            full_table.add(i);
+            ++num_added;
+        }
+    } catch (const std::runtime_error&) {
+    }
+    REQUIRE(full_table.get_num_elements() == static_cast<uint32_t>(num_added));
+    for (int i = 0; i < num_added; ++i) {
+        REQUIRE(full_table.contains(i));
+    }
+}
+
+TEST_CASE("Stats") {
+    HopscotchShadow<int> table{};
+    table.set_deleted_key(-1);
+    for (int i = 0; i < 1'000; ++i) {
+        table.insert(i);
+    }
+    for (int i = 0; i < 100; ++i) {
+        table.erase(i);
+    }
+    for (int i = 0; i < 2'000; ++i) {
+        table.contains(i);
+    }
+    HopscotchStats stats = table.stats();
+    REQUIRE(stats.tombstone_count == 100);
+    REQUIRE(std::accumulate(stats.home_distances.begin(),
+                            stats.home_distances.end(), uint64_t{0}) == 900);
+    REQUIRE(std::accumulate(stats.neighborhood_occupancy.begin(),
+                            stats.neighborhood_occupancy.end(),
+                            uint64_t{0}) == table.get_max_size());
+    REQUIRE(stats.home_distances.size() <= 32);
+    if constexpr (hopscotch_stats_enabled) {
+        REQUIRE(std::accumulate(stats.hit_probe_lengths.begin(),
+                                stats.hit_probe_lengths.end(),
+                                uint64_t{0}) == 900);
+        REQUIRE(std::accumulate(stats.miss_probe_lengths.begin(),
+                                stats.miss_probe_lengths.end(),
+                                uint64_t{0}) == 1'100);
+        REQUIRE(std::accumulate(stats.displacement_steps.begin(),
+                                stats.displacement_steps.end(),
+                                uint64_t{0}) == 1'000);
+        REQUIRE(stats.resize_attempts > 0);
+        table.reset_stats();
+        REQUIRE(table.stats().hit_probe_lengths.empty());
+    }
+
+    HopscotchHashSet<int> bitmaps_table{};
+    for (int i = 1; i <= 1'000; ++i) {
+        bitmaps_table.add(i);
+    }
+    for (int i = 0; i < 2'000; ++i) {
+        bitmaps_table.contains(i);
+    }
+    HopscotchStats bitmaps_stats = bitmaps_table.stats();
+    REQUIRE(bitmaps_stats.tombstone_count == 0);
+    REQUIRE(std::accumulate(bitmaps_stats.home_distances.begin(),
+                            bitmaps_stats.home_distances.end(),
+                            uint64_t{0}) == 1'000);
+    if constexpr (hopscotch_stats_enabled) {
+        REQUIRE(std::accumulate(bitmaps_stats.hit_probe_lengths.begin(),
+                                bitmaps_stats.hit_probe_lengths.end(),
+                                uint64_t{0}) == 1'000);
+        REQUIRE(std::accumulate(bitmaps_stats.displacement_steps.begin(),
+                                bitmaps_stats.displacement_steps.end(),
+                                uint64_t{0}) == 1'000);
+    }
+}
+
+TEMPLATE_TEST_CASE("Growth policies", "", PowerOfTwoGrowthPolicy,
+                   OneAndHalfGrowthPolicy, PrimeGrowthPolicy,
+                   LinearGrowthPolicy) {
+    std::mt19937 rng(42);
+    vector<int> keys(20'000);
+    std::iota(keys.begin(), keys.end(), 1);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    HopscotchShadow<int, std::hash<int>, TestType> table{};
+    table.set_deleted_key(-1);
+    HopscotchHashSet<int, 32, TestType> bitmaps_table{};
+    for (int k : keys) {
+        REQUIRE(table.insert(k).second);
+        bitmaps_table.add(k);
+    }
+    REQUIRE(table.get_max_size() == TestType::round_up(table.get_max_size()));
+    for (int i = 0; i < 10'000; ++i) {
+        REQUIRE(table.erase(keys[i]) == 1);
+        bitmaps_table.remove(keys[i]);
+    }
+    table.rehash(0);
+    bitmaps_table.rehash(0);
+    REQUIRE(table.get_size() == 10'000);
+    REQUIRE(bitmaps_table.get_num_elements() == 10'000);
+    for (int i = 0; i < 20'000; ++i) {
+        REQUIRE(table.contains(keys[i]) == (i >= 10'000));
+        REQUIRE(bitmaps_table.contains(keys[i]) == (i >= 10'000));
+    }
+}
+
+TEST_CASE("64-bit size type") {
+    // sizes past 2^32 only come from the policies, no table is built that big
+    REQUIRE(PrimeGrowthPolicy::round_up(5'000'000'000) == 8'589'934'583u);
+    // no prime to go to, the grow fails instead of not growing
+    const uint64_t last_prime = PrimeGrowthPolicy::primes.back();
+    REQUIRE_THROWS_AS(PrimeGrowthPolicy::round_up(last_prime + 1),
+                      std::length_error);
+    REQUIRE_THROWS_AS(PrimeGrowthPolicy::next_size(last_prime, 0),
+                      std::length_error);
+    REQUIRE_THROWS_AS(PrimeGrowthPolicy::next_size(uint64_t{1} << 62, 3),
+                      std::length_error);
+    REQUIRE(PowerOfTwoGrowthPolicy::round_up((uint64_t{1} << 33) + 1) ==
+            uint64_t{1} << 34);
+    REQUIRE(LinearGrowthPolicy::next_size(uint64_t{1} << 62, 0) ==
+            growth_detail::kMaxSize);
+    REQUIRE(growth_detail::to_size<uint64_t>(uint64_t{1} << 40) ==
+            uint64_t{1} << 40);
+    REQUIRE_THROWS(growth_detail::to_size<uint32_t>(uint64_t{1} << 32));
+
+    // a 32-bit table refuses before allocating anything
+    HopscotchShadow<int> small_table{};
+    REQUIRE_THROWS(small_table.reserve(3'000'000'000u));
+    HopscotchHashSet<int> small_bitmaps{};
+    REQUIRE_THROWS(small_bitmaps.reserve(3'000'000'000u));
+
+    HopscotchShadow<int, std::hash<int>, PowerOfTwoGrowthPolicy, false,
+                    uint64_t>
+        table{};
+    table.set_deleted_key(-1);
+    HopscotchHashSet<int, 32, LinearGrowthPolicy, uint64_t> bitmaps_table{};
+    static_assert(std::is_same_v<decltype(bitmaps_table.hash_key(0)),
+                                 uint64_t>);
+    for (int i = 0; i < 20'000; ++i) {
+        REQUIRE(table.insert(i).second);
+        bitmaps_table.add(i);
+    }
+    for (int i = 0; i < 10'000; ++i) {
+        REQUIRE(table.erase(i) == 1);
+        bitmaps_table.remove(i);
+    }
+    REQUIRE(table.get_size() == 10'000);
+    REQUIRE(bitmaps_table.get_num_elements() == 10'000);
+    for (int i = 0; i < 20'000; ++i) {
+        REQUIRE(table.contains(i) == (i >= 10'000));
+        REQUIRE(bitmaps_table.contains(i) == (i >= 10'000));
+    }
+    auto both = intersect(bitmaps_table, bitmaps_table.empty_copy());
+    REQUIRE(both.get_num_elements() == 0);
+}
+
+TEST_CASE("Reserve and rehash") {
+    HopscotchShadow<int> table{};
+    table.set_deleted_key(-1);
+    table.max_load_factor(0.5f);
+    REQUIRE_THROWS(table.max_load_factor(0.0f));
+    table.reserve(100'000);
+    uint32_t reserved_size = table.get_max_size();
+    REQUIRE(reserved_size >= 200'000);
+    for (int i = 0; i < 100'000; ++i) {
+        table.insert(i);
+    }
+    REQUIRE(table.get_max_size() == reserved_size);
+    REQUIRE(table.load_factor() <= 0.5f);
+    // growing past the reservation keeps the max load factor
+    for (int i = 100'000; i < 200'000; ++i) {
+        table.insert(i);
+    }
+    REQUIRE(table.load_factor() <= 0.5f);
+    table.rehash(1 << 22);
+    REQUIRE(table.get_max_size() == (1 << 22));
+    REQUIRE(table.get_size() == 200'000);
+    for (int i = 0; i < 200'000; ++i) {
+        REQUIRE(table.contains(i));
+    }
+
+    HopscotchHashSet<int> bitmaps_table{};
+    bitmaps_table.max_load_factor(0.5);
+    bitmaps_table.reserve(100'000);
+    vector<int> reserved_values = bitmaps_table.get_values();
+    REQUIRE(reserved_values.size() == 200'000);
+    for (int i = 0; i < 100'000; ++i) {
+        bitmaps_table.add(i);
+    }
+    REQUIRE(bitmaps_table.get_values().size() == 200'000);
+    for (int i = 100'000; i < 200'000; ++i) {
+        bitmaps_table.add(i);
+    }
+    REQUIRE(bitmaps_table.load_factor() <= 0.5);
+    bitmaps_table.rehash(1'000'000);
+    REQUIRE(bitmaps_table.get_values().size() == 1'000'000);
+    REQUIRE(bitmaps_table.get_num_elements() == 200'000);
+    for (int i = 0; i < 200'000; ++i) {
+        REQUIRE(bitmaps_table.contains(i));
+    }
+}
+
+TEST_CASE("Parallel resize") {
+    std::mt19937 rng(41);
+    std::uniform_int_distribution<int> dist(0, 1 << 30);
+    vector<int> keys(300'000);
+    for (int& key : keys) {
+        key = dist(rng);
+    }
+    HopscotchShadow<int> serial{};
+    HopscotchShadow<int> parallel{};
+    HopscotchShadow<int, std::hash<int>, PowerOfTwoGrowthPolicy, true>
+        parallel_hashed{};
+    serial.set_deleted_key(-1);
+    parallel.set_deleted_key(-1);
+    parallel.set_resize_threads(4);
+    parallel_hashed.set_erase_mode(EraseMode::BackwardShift);
+    parallel_hashed.set_resize_threads(3);
+    for (int key : keys) {
+        serial.insert(key);
+        parallel.insert(key);
+        parallel_hashed.insert(key);
+    }
+    // tombstones are dropped by the next rebuild
+    for (size_t i = 0; i < keys.size(); i += 3) {
+        serial.erase(keys[i]);
+        parallel.erase(keys[i]);
+        parallel_hashed.erase(keys[i]);
+    }
+    parallel.rehash(1 << 21);
+    parallel_hashed.rehash(1 << 21);
+    REQUIRE(parallel.tombstone_count == 0);
+    REQUIRE(parallel.get_size() == serial.get_size());
+    REQUIRE(parallel_hashed.get_size() == serial.get_size());
+    // every key is in its neighborhood, where bounded lookups stop
+    parallel.set_lookup_mode(LookupMode::Bounded);
+    parallel_hashed.set_lookup_mode(LookupMode::Bounded);
+    for (int key : keys) {
+        REQUIRE(parallel.contains(key) == serial.contains(key));
+        REQUIRE(parallel_hashed.contains(key) == serial.contains(key));
+    }
+}
+
+TEST_CASE("Snapshot readers") {
+    HopscotchShadow<int> init{};
+    init.set_deleted_key(-1);
+    SnapshotShadow<HopscotchShadow<int>> table(init);
+    auto reader = table.make_reader();
+    REQUIRE(table.insert(1));
+    REQUIRE(!table.insert(1));
+    REQUIRE(!reader.contains(1));
+    table.publish();
+    REQUIRE(reader.contains(1));
+    REQUIRE(table.erase(1));
+    REQUIRE(reader.contains(1));
+    table.publish();
+    REQUIRE(!reader.contains(1));
+    REQUIRE(table.num_unpublished() == 0);
+
+    // readers check keys that were published before they looked, while the
+    // writer keeps growing the table
+    const int num_keys = 200'000;
+    std::atomic<int> num_published{0};
+    std::atomic<bool> is_done{false};
+    std::atomic<int> num_missing{0};
+    auto read_keys = [&](unsigned seed) {
+        auto thread_reader = table.make_reader();
+        std::mt19937 rng(seed);
+        while (!is_done.load()) {
+            int upto = num_published.load();
+            if (upto == 0) continue;
+            int key = std::uniform_int_distribution<int>(0, upto - 1)(rng);
+            if (!thread_reader.contains(key)) ++num_missing;
+            // a snapshot doesn't change under a reader
+            thread_reader.read([&](const HopscotchShadow<int>& snapshot) {
+                size_t size = snapshot.get_size();
+                if (!snapshot.probe_hashed(key, snapshot.hash_key(key)) ||
+                    snapshot.get_size() != size) {
+                    ++num_missing;
+                }
+            });
+        }
+    };
+    vector<std::thread> readers{};
+    for (unsigned i = 0; i < 3; ++i) {
+        readers.emplace_back(read_keys, i);
+    }
+    for (int key = 0; key < num_keys; ++key) {
+        table.insert(key);
+        if (key % 1000 == 999) {
+            table.publish();
+            num_published = key + 1;
+        }
+    }
+    is_done = true;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    REQUIRE(num_missing == 0);
+    REQUIRE(table.published().get_size() == num_keys);
+    REQUIRE(table.published().get_max_size() >= num_keys);
+}
+
+TEST_CASE("Insert buffers") {
+    HopscotchShadow<int> shadow{};
+    InsertBuffers<HopscotchShadow<int>> shadow_buffers(shadow, 100);
+    {
+        auto producer = shadow_buffers.make_producer();
+        producer.insert(7);
+        REQUIRE(producer.num_buffered() == 1);
+        REQUIRE(!shadow_buffers.read([](const HopscotchShadow<int>& table) {
+            return table.contains(7);
+        }));
+        producer.flush();
+        REQUIRE(producer.num_buffered() == 0);
+        REQUIRE(shadow.contains(7));
+        producer.insert(8);
+    }
+    // flushed when the producer went away
+    REQUIRE(shadow.contains(8));
+
+    // producers on their own threads, the tables grow under them
+    // odd multiplier, distinct keys, never 0 (the deleted key), 7 or 8
+    auto key_of = [](int n) {
+        return static_cast<int>(static_cast<uint32_t>(n + 9) * 2654435761u);
+    };
+    HopscotchHashSet<int> bitmaps{};
+    InsertBuffers<HopscotchHashSet<int>> bitmaps_buffers(bitmaps, 1000);
+    const int keys_per_thread = 50'000;
+    vector<std::thread> producers{};
+    for (int thread = 0; thread < 4; ++thread) {
+        producers.emplace_back([&, thread] {
+            auto shadow_producer = shadow_buffers.make_producer();
+            auto bitmaps_producer = bitmaps_buffers.make_producer();
+            for (int i = 0; i < keys_per_thread; ++i) {
+                int key = key_of(thread * keys_per_thread + i);
+                shadow_producer.insert(key);
+                // repeats in a batch are all kept
+                bitmaps_producer.insert(key_of(i / 2));
+            }
+            shadow_producer.flush();
+        });
+    }
+    for (auto& thread : producers) {
+        thread.join();
+    }
+    REQUIRE(shadow.get_size() == 4 * keys_per_thread + 2);
+    REQUIRE(bitmaps.get_num_elements() == 4 * keys_per_thread);
+    for (int n = 0; n < 4 * keys_per_thread; ++n) {
+        REQUIRE(shadow.contains(key_of(n)));
+    }
+    for (int i = 0; i < keys_per_thread; ++i) {
+        REQUIRE(bitmaps.contains(key_of(i / 2)));
+    }
+}
+
+TEST_CASE("Dedup files") {
+    auto dir = std::filesystem::temp_directory_path();
+    std::string prefix = "hopscotch_test_dedup_" + std::to_string(getpid());
+    auto first = (dir / (prefix + "_1.bin")).string();
+    auto second = (dir / (prefix + "_2.bin")).string();
+    auto empty = (dir / (prefix + "_3.bin")).string();
+    // 0 is an ordinary key, a trailing partial key is skipped
+    vector<uint64_t> first_keys = {5, 0, 5, 7, 1ull << 40, 0};
+    vector<uint64_t> second_keys = {7, 9, 1ull << 40, 9, 11};
+    {
+        std::ofstream out(first, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(first_keys.data()),
+                  first_keys.size() * sizeof(uint64_t));
+        out.write("abc", 3);
+        std::ofstream(second, std::ios::binary)
+            .write(reinterpret_cast<const char*>(second_keys.data()),
+                   second_keys.size() * sizeof(uint64_t));
+        std::ofstream(empty, std::ios::binary);
+    }
+    const vector<uint64_t> expected = {5, 0, 7, 1ull << 40, 9, 11};
+
+    HopscotchShadow<uint64_t> shadow{};
+    shadow.set_erase_mode(EraseMode::BackwardShift);
+    vector<uint64_t> unique{};
+    DedupStats stats =
+        dedup_files(shadow, {first, empty, second},
+                    [&](uint64_t key) { unique.push_back(key); });
+    REQUIRE(unique == expected);
+    REQUIRE(stats.num_keys == 11);
+    REQUIRE(stats.num_unique == 6);
+    REQUIRE(stats.num_bytes == 11 * sizeof(uint64_t) + 3);
+
+    HopscotchHashSet<uint64_t> bitmaps{};
+    unique.clear();
+    stats = dedup_files(bitmaps, {first, empty, second},
+                        [&](uint64_t key) { unique.push_back(key); });
+    REQUIRE(unique == expected);
+    REQUIRE(bitmaps.get_num_elements() == 6);
+
+    REQUIRE_THROWS(dedup_files(bitmaps, {(dir / (prefix + "_missing.bin")).string()},
+                               [](uint64_t) {}));
+
+    // auto-increment IDs 2^20 apart, all of them share a home without mixing
+    vector<uint64_t> strided_keys{};
+    for (uint64_t i = 1; i <= 20'000; ++i) {
+        strided_keys.push_back(i << 20);
+        strided_keys.push_back(i << 20);
+    }
+    std::ofstream(first, std::ios::binary)
+        .write(reinterpret_cast<const char*>(strided_keys.data()),
+               strided_keys.size() * sizeof(uint64_t));
+    DedupShadow<uint64_t> strided{};
+    strided.set_erase_mode(EraseMode::BackwardShift);
+    stats = dedup_files(strided, {first}, [](uint64_t) {});
+    REQUIRE(stats.num_unique == 20'000);
+    for (uint64_t i = 1; i <= 20'000; ++i) {
+        REQUIRE(strided.contains(i << 20));
+    }
+
+    std::filesystem::remove(first);
+    std::filesystem::remove(second);
+    std::filesystem::remove(empty);
+}
+
+TEST_CASE("Hash mixing") {
+    // keys 2^16 apart share a home in every table of up to 2^16 slots
+    auto stride_keys = vector<int>(20'000);
+    for (int i = 0; i < static_cast<int>(stride_keys.size()); ++i) {
+        stride_keys[i] = i << 16;
+    }
+    HopscotchShadow<int> plain{};
+    plain.set_deleted_key(-1);
+    REQUIRE_THROWS([&] {
+        for (int key : stride_keys) {
+            plain.insert(key);
+        }
+    }());
+
+    using Fibonacci =
+        HopscotchShadow<int, std::hash<int>, PowerOfTwoGrowthPolicy, false,
+                        uint32_t, SparseStorage, FibonacciMixing>;
+    using Murmur3 =
+        HopscotchShadow<int, std::hash<int>, PowerOfTwoGrowthPolicy, true,
+                        uint32_t, SparseStorage, Murmur3Mixing>;
+    Fibonacci fibonacci{};
+    Murmur3 murmur3{};
+    Murmur3 seeded{};
+    fibonacci.set_deleted_key(-1);
+    murmur3.set_deleted_key(-1);
+    seeded.set_deleted_key(-1);
+    seeded.set_hash_seed(42);
+    for (int key : stride_keys) {
+        fibonacci.insert(key);
+        murmur3.insert(key);
+        seeded.insert(key);
+    }
+    // and sequential ones, erased and put back over rebuilds
+    for (int key = 1; key <= 100'000; ++key) {
+        murmur3.insert(key);
+        seeded.insert(key);
+    }
+    for (int key = 1; key <= 100'000; key += 2) {
+        murmur3.erase(key);
+    }
+    murmur3.rehash(murmur3.get_max_size());
+    for (int key : stride_keys) {
+        REQUIRE(fibonacci.contains(key));
+        REQUIRE(murmur3.contains(key));
+        REQUIRE(seeded.contains(key));
+    }
+    for (int key = 1; key <= 100'000; ++key) {
+        REQUIRE(murmur3.contains(key) == (key % 2 == 0));
+    }
+    REQUIRE(fibonacci.get_size() == stride_keys.size());
+    REQUIRE_THROWS(seeded.set_hash_seed(7));
+
+    // homes differ with the seed, so bulk operations can't walk side by side
+    Murmur3 other = seeded.empty_copy();
+    REQUIRE(other.hash_seed == 42);
+    other.rehash(seeded.get_max_size());
+    REQUIRE(other.is_aligned_with(seeded));
+    other = murmur3.empty_copy();
+    other.rehash(seeded.get_max_size());
+    REQUIRE(!other.is_aligned_with(seeded));
+    for (int key = 0; key < 1000; ++key) {
+        other.insert(key);
+    }
+    // 0 is a stride key
+    REQUIRE(intersect(other, seeded, 2).get_size() == 1000);
+}
+
+TEST_CASE("Sparse group storage") {
+    SparseGroupTable<int> table(200);
+    // filled out of order, items stay in slot order within a group
+    for (int i : {70, 5, 63, 64, 0, 199, 6}) {
+        table.set(i, i * 10);
+    }
+    REQUIRE(table.num_nonempty() == 7);
+    REQUIRE(table.get(5) == 50);
+    REQUIRE(table.get(64) == 640);
+    REQUIRE(table.get(1) == 0);
+    REQUIRE(!table.test(1));
+    vector<int> walked{};
+    for (auto it = table.nonempty_begin(); it != table.nonempty_end(); ++it) {
+        walked.push_back(*it);
+    }
+    REQUIRE(walked == vector<int>{0, 50, 60, 630, 640, 700, 1990});
+
+    // runs cross group ends and the table end, and stop at an empty slot
+    size_t steps = 0;
+    auto equals = [](int val) {
+        return [val](int item) { return item == val; };
+    };
+    REQUIRE(table.find_in_run(63, 10, equals(640), steps) == 64);
+    REQUIRE(steps == 1);
+    REQUIRE(table.find_in_run(199, 10, equals(0), steps) == 0);
+    REQUIRE(table.find_in_run(199, 10, equals(60), steps) == 200);
+    REQUIRE(steps == 2);
+    REQUIRE(table.find_in_run(5, 1, equals(60), steps) == 200);
+    REQUIRE(steps == 1);
+
+    table.erase(5);
+    table.erase(5);
+    REQUIRE(table.get(6) == 60);
+    table.resize(100);
+    REQUIRE(table.num_nonempty() == 5);
+
+    // grows and gives memory back as a group fills and empties
+    for (int i = 0; i < 64; ++i) {
+        table.set(i, i);
+    }
+    size_t full = table.memory_usage();
+    for (int i = 0; i < 60; ++i) {
+        table.erase(i);
+    }
+    REQUIRE(table.memory_usage() < full);
+    SparseGroupTable<int> copy = table;
+    for (int i = 60; i < 64; ++i) {
+        REQUIRE(copy.get(i) == i);
+    }
+
+    // the shadow table on it, with tombstones and backward shift
+    for (EraseMode mode : {EraseMode::Tombstone, EraseMode::BackwardShift}) {
+        HopscotchShadow<int, std::hash<int>, PowerOfTwoGrowthPolicy, true,
+                        uint32_t, SparseGroupStorage>
+            shadow{};
+        shadow.set_deleted_key(-1);
+        shadow.set_erase_mode(mode);
+        std::mt19937 rng(7);
+        vector<int> keys(200'000);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), rng);
+        for (int key : keys) {
+            REQUIRE(shadow.insert(key).second);
+        }
+        for (int key = 0; key < 200'000; key += 3) {
+            REQUIRE(shadow.erase(key) == 1);
+        }
+        for (int key = 0; key < 200'000; ++key) {
+            REQUIRE(shadow.contains(key) == (key % 3 != 0));
+        }
+        REQUIRE(!shadow.contains(200'000));
+    }
+}
+
+TEST_CASE("Memory policies") {
+    using DenseShadow = HopscotchShadow<int, std::hash<int>,
+                                        PowerOfTwoGrowthPolicy, false,
+                                        uint32_t, DenseStorage>;
+    // tables past 2MB are mapped, hugetlbfs falls back when it has no pages
+    vector<MemoryPolicy> policies = {
+        {}, {PageMode::Transparent}, {PageMode::HugeTlb},
+        {PageMode::Default, NumaMode::Interleave}};
+    for (const MemoryPolicy& policy : policies) {
+        HopscotchHashSet<int> bitmaps_table{};
+        bitmaps_table.set_memory_policy(policy);
+        DenseShadow shadow_table{};
+        shadow_table.set_memory_policy(policy);
+        shadow_table.set_deleted_key(-1);
+        for (int i = 0; i < 500'000; ++i) {
+            bitmaps_table.add(i);
+            shadow_table.insert(i);
+        }
+        for (int i = 0; i < 500'000; i += 2) {
+            shadow_table.erase(i);
+        }
+        // growing keeps the policy
+        REQUIRE(bitmaps_table.memory_policy() == policy);
+        REQUIRE(shadow_table.vals.memory_policy() == policy);
+        REQUIRE(bitmaps_table.get_num_elements() == 500'000);
+        REQUIRE(shadow_table.get_size() == 250'000);
+        for (int i = 0; i < 500'000; ++i) {
+            REQUIRE(bitmaps_table.contains(i));
+            REQUIRE(shadow_table.contains(i) == (i % 2 == 1));
+        }
+        REQUIRE(!bitmaps_table.contains(500'000));
+    }
+
+    DenseShadow table{};
+    table.set_memory_policy({PageMode::Default, NumaMode::Bind, -1});
+    // small tables come from operator new, whatever the policy
+    table.insert(1);
+    REQUIRE_THROWS(table.reserve(1'000'000));
+    REQUIRE(table.contains(1));
+}
+
+TEST_CASE("Mapped storage") {
+    using MappedSet =
+        HopscotchHashSet<int, 32, LinearGrowthPolicy, uint32_t, MappedStorage>;
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("hopscotch_test_" + std::to_string(getpid()) + ".set"))
+                           .string();
+    std::filesystem::remove(path);
+    {
+        MappedSet table{};
+        REQUIRE_THROWS(table.add(1));  // no file yet
+        table.open(path);
+        REQUIRE(table.get_num_elements() == 0);
+        // grows a few times, every rebuild switches the file to a new table
+        for (int i = 0; i < 200'000; ++i) {
+            table.add(i);
+        }
+        table.remove(0);
+        table.sync();
+    }
+    {
+        // no load step, the keys are where the last rebuild put them
+        MappedSet table{};
+        table.open(path);
+        REQUIRE(table.get_num_elements() == 199'999);
+        REQUIRE(!table.contains(0));
+        for (int i = 1; i < 200'000; ++i) {
+            REQUIRE(table.contains(i));
+        }
+        for (int i = 200'000; i < 400'000; ++i) {
+            table.add(i);
+        }
+        // not synced, the page cache still has the keys
+    }
+    {
+        MappedSet table{};
+        table.open(path);
+        REQUIRE(table.get_num_elements() == 399'999);
+        for (int i = 1; i < 400'000; ++i) {
+            REQUIRE(table.contains(i));
+        }
+        // an empty copy shares the file, but never becomes its table
+        MappedSet copy = table.empty_copy();
+        copy.init();
+        copy.add(-1);
+    }
+    {
+        MappedSet table{};
+        table.open(path);
+        REQUIRE(table.get_num_elements() == 399'999);
+        REQUIRE(!table.contains(-1));
+    }
+    {
+        // re-inits of the table the file opens to free the old regions
+        MappedSet table{};
+        table.open(path);
+        table.init(1 << 16);
+        struct stat st;
+        REQUIRE(stat(path.c_str(), &st) == 0);
+        blkcnt_t num_blocks = st.st_blocks;
+        for (int i = 0; i < 8; ++i) {
+            table.init(1 << 16);
+        }
+        REQUIRE(stat(path.c_str(), &st) == 0);
+        REQUIRE(st.st_blocks == num_blocks);
+    }
+    // other slots or neighborhoods than the file was written with
+    HopscotchHashSet<int, 16, LinearGrowthPolicy, uint32_t, MappedStorage>
+        narrow{};
+    REQUIRE_THROWS(narrow.open(path));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Shrink") {
+    HopscotchShadow<int> table{};
+    table.set_deleted_key(-1);
+    for (int i = 0; i < 100'000; ++i) {
+        table.insert(i);
+    }
+    uint32_t peak_size = table.get_max_size();
+    for (int i = 1'000; i < 100'000; ++i) {
+        table.erase(i);
+    }
+    REQUIRE(table.get_max_size() == peak_size);
+    REQUIRE(table.shrink_to_fit());
+    REQUIRE(table.get_max_size() < peak_size);
+    REQUIRE(table.get_size() == 1'000);
+    REQUIRE(table.stats().tombstone_count == 0);
+    REQUIRE_FALSE(table.shrink_to_fit());
+    for (int i = 0; i < 2'000; ++i) {
+        REQUIRE(table.contains(i) == (i < 1'000));
+    }
+
+    HopscotchShadow<int> auto_table{};
+    auto_table.set_deleted_key(-1);
+    auto_table.min_load_factor(0.1f);
+    REQUIRE_THROWS(auto_table.min_load_factor(1.0f));
+    for (int i = 0; i < 100'000; ++i) {
+        auto_table.insert(i);
+    }
+    for (int i = 0; i < 99'000; ++i) {
+        auto_table.erase(i);
+        REQUIRE(auto_table.get_size() >= 0.1f * auto_table.get_max_size());
+    }
+    REQUIRE(auto_table.get_max_size() < peak_size);
+    for (int i = 0; i < 100'000; ++i) {
+        REQUIRE(auto_table.contains(i) == (i >= 99'000));
+    }
+
+    HopscotchHashSet<int> bitmaps_table{};
+    bitmaps_table.min_load_factor(0.1);
+    for (int i = 0; i < 100'000; ++i) {
+        bitmaps_table.add(i);
+    }
+    size_t bitmaps_peak_size = bitmaps_table.get_values().size();
+    for (int i = 0; i < 99'000; ++i) {
+        bitmaps_table.remove(i);
+    }
+    REQUIRE(bitmaps_table.get_values().size() < bitmaps_peak_size);
+    REQUIRE(bitmaps_table.load_factor() >= 0.1);
+    bitmaps_table.min_load_factor(0.0);
+    for (int i = 99'000; i < 99'900; ++i) {
+        bitmaps_table.remove(i);
+    }
+    REQUIRE(bitmaps_table.shrink_to_fit());
+    REQUIRE(bitmaps_table.get_values().size() < 1'000);
+    REQUIRE(bitmaps_table.get_num_elements() == 100);
+    for (int i = 0; i < 100'000; ++i) {
+        REQUIRE(bitmaps_table.contains(i) == (i >= 99'900));
+    }
+}
+
+// every key's home is a multiple of 1024, tables up to that size put them all
+// into bucket 0
+struct StrideHash {
+    size_t operator()(int key) const { return static_cast<size_t>(key) << 10; }
+};
+
+TEST_CASE("Shrink that doesn't fit") {
+    // 40 keys in one neighborhood of 32 only fit into a big table, erases
+    // must not rebuild on every key after the shrink failed once
+    HopscotchShadow<int, StrideHash> table{};
+    table.set_deleted_key(-1);
+    table.min_load_factor(0.1f);
+    table.rehash(1 << 16);
+    for (int i = 0; i < 40; ++i) {
+        table.insert(i);
+    }
+    table.reset_stats();
+    table.erase(39);
+    REQUIRE(table.get_max_size() == 1 << 16);
+    uint64_t attempts = table.stats().resize_attempts;
+    REQUIRE(attempts > 0);
+    for (int i = 38; i >= 20; --i) {
+        table.erase(i);
+    }
+    REQUIRE(table.stats().resize_attempts == attempts);
+    // half of the keys are gone, 19 fit into one neighborhood
+    table.erase(19);
+    REQUIRE(table.get_max_size() < 1 << 16);
+    for (int i = 0; i < 40; ++i) {
+        REQUIRE(table.contains(i) == (i < 19));
+    }
+
+    // a neighborhood of 1 slot: keys only fit where no two share a home,
+    // which a table of 2^22 slots gives 300 keys but one of 2 * 300 doesn't
+    // (consecutive ints hash too evenly for that, odd multiplier scatters)
+    auto key_of = [](int i) {
+        return static_cast<int>(static_cast<uint32_t>(i) * 2654435761u);
+    };
+    HopscotchHashSet<int, 1> bitmaps_table{};
+    bitmaps_table.min_load_factor(0.1);
+    bitmaps_table.rehash(1 << 22);
+    for (int i = 0; i < 300; ++i) {
+        bitmaps_table.add(key_of(i));
+    }
+    auto bitmaps_size = bitmaps_table.bucket_count();
+    bitmaps_table.reset_stats();
+    bitmaps_table.remove(key_of(299));
+    REQUIRE(bitmaps_table.bucket_count() == bitmaps_size);
+    uint64_t bitmaps_attempts = bitmaps_table.stats().resize_attempts;
+    REQUIRE(bitmaps_attempts > 0);
+    for (int i = 298; i >= 150; --i) {
+        bitmaps_table.remove(key_of(i));
+    }
+    REQUIRE(bitmaps_table.stats().resize_attempts == bitmaps_attempts);
+    REQUIRE(bitmaps_table.get_num_elements() == 150);
+}
+
+// adds until num_allowed keys are in, then throws, like a grow that fails
+struct FailingTable {
+    using key_type = int;
+    using growth_policy = PowerOfTwoGrowthPolicy;
+    vector<int> added{};
+    size_t num_allowed = 0;
+    uint64_t bucket_count() const { return 64; }
+    uint64_t hash_key(int key) const { return static_cast<uint64_t>(key); }
+    FailingTable empty_copy() const { return {}; }
+    void add(int key) {
+        if (added.size() == num_allowed) throw std::runtime_error("full");
+        added.push_back(key);
+    }
+};
+
+TEST_CASE("Insert buffers failed flush") {
+    FailingTable table{};
+    table.num_allowed = 30;
+    InsertBuffers<FailingTable> buffers(table, 1000);
+    auto producer = buffers.make_producer();
+    for (int key = 0; key < 100; ++key) {
+        producer.insert(key);
+    }
+    REQUIRE_THROWS_AS(producer.flush(), std::runtime_error);
+    REQUIRE(table.added.size() == 30);
+    REQUIRE(producer.num_buffered() == 70);
+    table.num_allowed = 100;
+    producer.flush();
+    REQUIRE(producer.num_buffered() == 0);
+    // every key once, none of the first 30 again
+    std::sort(table.added.begin(), table.added.end());
+    for (int key = 0; key < 100; ++key) {
+        REQUIRE(table.added[key] == key);
+    }
+    REQUIRE(table.added.size() == 100);
+}
+
+// counts calls, to check which paths hash keys again
+struct CountingHash {
+    static inline uint64_t num_calls = 0;
+    size_t operator()(const std::string& key) const {
+        ++num_calls;
+        return std::hash<std::string>{}(key);
+    }
+};
+
+TEST_CASE("Stored hashes") {
+    HopscotchShadow<std::string, CountingHash, PowerOfTwoGrowthPolicy, true>
+        table{};
+    table.set_deleted_key("");
+    CountingHash::num_calls = 0;
+    for (int i = 0; i < 10'000; ++i) {
+        REQUIRE(table.insert(std::to_string(i)).second);
+    }
+    // one call per insert, resizes and displacements use the stored hash
+    REQUIRE(CountingHash::num_calls == 10'000);
+    REQUIRE(table.get_max_size() > 64);
+    REQUIRE_FALSE(table.insert("42").second);
+    for (int i = 0; i < 10'000; i += 2) {
+        REQUIRE(table.erase(std::to_string(i)) == 1);
+    }
+    for (int i = 0; i < 20'000; ++i) {
+        REQUIRE(table.contains(std::to_string(i)) == (i < 10'000 && i % 2));
+    }
+    HopscotchStats stats = table.stats();
+    REQUIRE(stats.home_distances.size() <= 32);
+    REQUIRE(std::accumulate(stats.home_distances.begin(),
+                            stats.home_distances.end(), uint64_t{0}) == 5'000);
+
+    HopscotchShadow<std::string, CountingHash> plain_table{};
+    plain_table.set_deleted_key("");
+    CountingHash::num_calls = 0;
+    for (int i = 0; i < 10'000; ++i) {
+        plain_table.insert(std::to_string(i));
+    }
+    REQUIRE(CountingHash::num_calls > 10'000);
+}
+
+TEST_CASE("Bounded lookup") {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> distrib(0, 1'000'000'000);
+    HopscotchShadow<int> table{};
+    table.set_deleted_key(-1);
+    table.set_size(1 << 17);
+    table.max_load_factor(0.9f);
+    vector<int> keys(200'000);
+    for (int& key : keys) {
+        key = distrib(rng);
+    }
+    for (int i = 0; i < 110'000; ++i) {
+        table.insert(keys[i]);
+    }
+    for (int i = 0; i < 110'000; i += 3) {
+        table.erase(keys[i]);
+    }
+    vector<bool> expected{};
+    for (int key : keys) {
+        expected.push_back(table.contains(key));
+    }
+    table.set_lookup_mode(LookupMode::Bounded);
+    table.reset_stats();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        REQUIRE(table.contains(keys[i]) == expected[i]);
+    }
+    if constexpr (hopscotch_stats_enabled) {
+        HopscotchStats stats = table.stats();
+        REQUIRE(stats.miss_probe_lengths.size() <= 33);
+        REQUIRE(stats.hit_probe_lengths.size() <= 33);
+    }
+}
+
+TEST_CASE("Erase modes") {
+    for (EraseMode mode : {EraseMode::Tombstone, EraseMode::BackwardShift}) {
+        std::mt19937 rng(3);
+        std::uniform_int_distribution<int> distrib(0, 100'000);
+        HopscotchShadow<int> table{};
+        table.set_erase_mode(mode);
+        if (mode == EraseMode::Tombstone) {
+            table.set_deleted_key(-1);
+        }
+        // with backward shift 0 == int{} is an ordinary key
+        unordered_set<int> expected{0};
+        table.insert(0);
+        for (int i = 0; i < 300'000; ++i) {
+            int key = distrib(rng);
+            if (rng() % 2) {
+                REQUIRE(table.insert(key).second == expected.insert(key).second);
+            } else {
+                REQUIRE(table.erase(key) == expected.erase(key));
+            }
+            REQUIRE(table.get_size() == expected.size());
+        }
+        for (int key = 0; key <= 100'000; ++key) {
+            REQUIRE(table.contains(key) == expected.contains(key));
+        }
+        HopscotchStats stats = table.stats();
+        REQUIRE(stats.home_distances.size() <= 32);
+        if (mode == EraseMode::BackwardShift) {
+            REQUIRE(stats.tombstone_count == 0);
+            REQUIRE(table.vals.num_nonempty() == expected.size());
+        }
+    }
+
+    // switching drops the tombstones
+    HopscotchShadow<int> table{};
+    table.set_deleted_key(-1);
+    for (int i = 0; i < 1'000; ++i) {
+        table.insert(i);
+    }
+    for (int i = 0; i < 1'000; i += 2) {
+        table.erase(i);
+    }
+    table.set_erase_mode(EraseMode::BackwardShift);
+    REQUIRE(table.vals.num_nonempty() == 500);
+    for (int i = 0; i < 1'000; ++i) {
+        REQUIRE(table.contains(i) == (i % 2 == 1));
+    }
+}
+
+TEST_CASE("Erase if") {
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> distrib(0, 1'000'000);
+    vector<int> keys(200'000);
+    for (int& key : keys) {
+        key = distrib(rng);
+    }
+    auto is_expired = [](int key) { return key % 3 == 0; };
+    for (unsigned num_threads : {1u, 4u}) {
+        for (EraseMode mode : {EraseMode::Tombstone, EraseMode::BackwardShift}) {
+            HopscotchShadow<int> table{};
+            table.set_deleted_key(-1);
+            table.set_erase_mode(mode);
+            unordered_set<int> expected{};
+            for (int key : keys) {
+                table.insert(key);
+                expected.insert(key);
+            }
+            // leaves tombstones, and keys displaced past them
+            for (int i = 0; i < 50'000; ++i) {
+                table.erase(keys[i]);
+                expected.erase(keys[i]);
+            }
+            size_t num_expired = std::erase_if(expected, is_expired);
+            REQUIRE(table.erase_if(is_expired, num_threads) == num_expired);
+            REQUIRE(table.get_size() == expected.size());
+            REQUIRE(table.vals.num_nonempty() == expected.size());
+            REQUIRE(table.stats().home_distances.size() <= 32);
+            for (int key = 0; key <= 1'000'000; ++key) {
+                REQUIRE(table.contains(key) == expected.contains(key));
+            }
+            REQUIRE(table.insert(3).second);
+            REQUIRE(table.contains(3));
+        }
+
+        // keeps repeats, erase_if takes every copy
+        HopscotchHashSet<int> bitmaps{};
+        unordered_multiset<int> expected{};
+        for (int i = 0; i < 100'000; ++i) {
+            bitmaps.add(keys[i]);
+            expected.insert(keys[i]);
+        }
+        for (int i = 0; i < 1'000; ++i) {
+            bitmaps.add(keys[i]);
+            expected.insert(keys[i]);
+        }
+        size_t num_expired = std::erase_if(expected, is_expired);
+        REQUIRE(bitmaps.erase_if(is_expired, num_threads) == num_expired);
+        REQUIRE(bitmaps.get_num_elements() == expected.size());
+        for (int key = 0; key <= 1'000'000; ++key) {
+            REQUIRE(bitmaps.contains(key) == expected.contains(key));
+        }
+        REQUIRE(bitmaps.erase_if(is_expired, num_threads) == 0);
+    }
+
+    // a pred that throws leaves every run compacted or untouched
+    HopscotchShadow<int> table{};
+    table.set_erase_mode(EraseMode::BackwardShift);
+    for (int i = 0; i < 20'000; ++i) {
+        table.insert(keys[i]);
+    }
+    unordered_set<int> picked{};
+    REQUIRE_THROWS(table.erase_if([&](int key) {
+        if (picked.size() == 1'000) throw std::runtime_error("stop");
+        if (key % 2 == 0) picked.insert(key);
+        return key % 2 == 0;
+    }));
+    unordered_set<int> inserted(keys.begin(), keys.begin() + 20'000);
+    size_t num_found = 0;
+    for (int key : inserted) {
+        bool is_found = table.contains(key);
+        REQUIRE((is_found || picked.contains(key)));
+        num_found += is_found;
+    }
+    REQUIRE(table.get_size() == num_found);
+    // runs before the one that threw are compacted
+    REQUIRE(num_found < inserted.size());
+}
+
+TEST_CASE("Lookup pipeline") {
+    std::mt19937 rng(37);
+    std::uniform_int_distribution<int> distrib(0, 200'000);
+    vector<int> keys(100'000);
+    for (int& v : keys) {
+        v = distrib(rng);
+    }
+    vector<int> lookups(50'000);
+    for (int& v : lookups) {
+        v = distrib(rng);
+    }
+
+    HopscotchShadow<int> shadow{};
+    shadow.set_deleted_key(-1);
+    HopscotchHashSet<int> bitmaps{};
+    for (int v : keys) {
+        shadow.insert(v);
+        bitmaps.add(v);
+    }
+    vector<bool> expected{};
+    for (int v : lookups) {
+        expected.push_back(shadow.contains(v));
+        REQUIRE(expected.back() == bitmaps.contains(v));
+    }
+
+    REQUIRE(LookupPipeline(shadow).contains(lookups.begin(), lookups.end()) ==
+            expected);
+    REQUIRE(LookupPipeline(bitmaps).contains(lookups.begin(), lookups.end()) ==
+            expected);
+    // more workers than keys, and a single one
+    REQUIRE(LookupPipeline<HopscotchShadow<int>, 64>(shadow).contains(
+                lookups.begin(), lookups.begin() + 10) ==
+            vector<bool>(expected.begin(), expected.begin() + 10));
+    REQUIRE(LookupPipeline<HopscotchHashSet<int>, 1>(bitmaps).contains(
+                lookups.begin(), lookups.end()) == expected);
+    REQUIRE(LookupPipeline(shadow).contains(lookups.end(), lookups.end())
+                .empty());
+
+    // every index is reported once
+    vector<int> seen(lookups.size());
+    LookupPipeline(bitmaps).run(lookups.begin(), lookups.end(),
+                                [&seen](size_t index, bool) { ++seen[index]; });
+    REQUIRE(std::ranges::all_of(seen, [](int c) { return c == 1; }));
+}
+
+TEST_CASE("Counting set") {
+    HopscotchCountingSet<int> table{};
+    REQUIRE(table.count(5) == 0);
+    REQUIRE_FALSE(table.contains(5));
+    // far more copies than a neighborhood holds
+    for (int i = 0; i < 1'000; ++i) {
+        REQUIRE(table.increment(5) == static_cast<uint32_t>(i + 1));
+    }
+    REQUIRE(table.increment(0, 10) == 10);  // default value is an ordinary key
+    REQUIRE(table.get_num_elements() == 2);
+    REQUIRE(table.total_count() == 1'010);
+    REQUIRE(table.decrement(5, 999) == 1);
+    REQUIRE(table.decrement(5) == 0);
+    REQUIRE_FALSE(table.contains(5));
+    REQUIRE_THROWS(table.decrement(5));
+    REQUIRE_THROWS(table.decrement(0, 11));
+    REQUIRE(table.erase(0) == 10);
+    REQUIRE(table.get_num_elements() == 0);
+    REQUIRE(table.total_count() == 0);
+
+    HopscotchCountingSet<int, 32, LinearGrowthPolicy, uint8_t> small{};
+    small.increment(1, 200);
+    REQUIRE_THROWS(small.increment(1, 100));
+    REQUIRE(small.count(1) == 200);
+
+    // random increments and decrements against unordered_map, through resizes
+    std::mt19937 rng(38);
+    std::uniform_int_distribution<int> distrib(0, 50'000);
+    std::unordered_map<int, uint32_t> expected{};
+    for (int i = 0; i < 300'000; ++i) {
+        int key = distrib(rng);
+        uint32_t delta = rng() % 4 + 1;
+        auto it = expected.find(key);
+        if (it != expected.end() && rng() % 3 == 0) {
+            delta = std::min(delta, it->second);
+            REQUIRE(table.decrement(key, delta) == it->second - delta);
+            if ((it->second -= delta) == 0) expected.erase(it);
+        } else {
+            REQUIRE(table.increment(key, delta) == (expected[key] += delta));
+        }
+    }
+    REQUIRE(table.get_num_elements() == expected.size());
+    uint64_t total = 0;
+    size_t num_keys = 0;
+    table.for_each([&](int key, uint32_t count) {
+        REQUIRE(expected.at(key) == count);
+        total += count;
+        ++num_keys;
+    });
+    REQUIRE(num_keys == expected.size());
+    REQUIRE(total == table.total_count());
+    for (int key = 0; key <= 50'000; ++key) {
+        auto it = expected.find(key);
+        REQUIRE(table.count(key) == (it == expected.end() ? 0 : it->second));
+    }
+}
+
+TEST_CASE("Set algebra") {
+    std::mt19937 rng(39);
+    std::uniform_int_distribution<int> distrib(0, 100'000);
+    vector<int> keys_a(60'000);
+    vector<int> keys_b(60'000);
+    for (int& v : keys_a) {
+        v = distrib(rng);
+    }
+    for (int& v : keys_b) {
+        v = distrib(rng);
+    }
+    std::unordered_set<int> set_a(keys_a.begin(), keys_a.end());
+    std::unordered_set<int> set_b(keys_b.begin(), keys_b.end());
+
+    auto check = [&](const auto& table, auto&& expected_has) {
+        uint32_t num_expected = 0;
+        for (int key = 0; key <= 100'000; ++key) {
+            bool expected = expected_has(key);
+            num_expected += expected;
+            REQUIRE(table.contains(key) == expected);
+        }
+        return num_expected;
+    };
+    auto in_a = [&](int key) { return set_a.contains(key); };
+    auto in_b = [&](int key) { return set_b.contains(key); };
+
+    for (unsigned num_threads : {1u, 4u}) {
+        // aligned: same size; then b resized to something else
+        for (bool is_aligned : {true, false}) {
+            HopscotchShadow<int> shadow_a{};
+            HopscotchShadow<int> shadow_b{};
+            shadow_a.set_deleted_key(-1);
+            shadow_b.set_deleted_key(-1);
+            shadow_a.reserve(100'000);
+            shadow_b.reserve(is_aligned ? 100'000 : 300'000);
+            HopscotchHashSet<int> bitmaps_a(128, 5, 1);
+            HopscotchHashSet<int> bitmaps_b(128, 5, is_aligned ? 1 : 2);
+            bitmaps_a.reserve(100'000);
+            bitmaps_b.reserve(100'000);
+            for (int v : set_a) {
+                shadow_a.insert(v);
+                bitmaps_a.add(v);
+            }
+            for (int v : set_b) {
+                shadow_b.insert(v);
+                bitmaps_b.add(v);
+            }
+            // a tombstone must not come out as a key
+            int erased = *set_a.begin();
+            shadow_a.erase(erased);
+            bitmaps_a.remove(erased);
+            set_a.erase(erased);
+            REQUIRE(shadow_a.is_aligned_with(shadow_b) == is_aligned);
+            REQUIRE(bitmaps_a.is_aligned_with(bitmaps_b) == is_aligned);
+
+            auto both = [&](int key) { return in_a(key) && in_b(key); };
+            auto only_a = [&](int key) { return in_a(key) && !in_b(key); };
+            auto either = [&](int key) { return in_a(key) || in_b(key); };
+            auto shadow_and = intersect(shadow_a, shadow_b, num_threads);
+            REQUIRE(shadow_and.get_size() == check(shadow_and, both));
+            auto shadow_minus = difference(shadow_a, shadow_b, num_threads);
+            REQUIRE(shadow_minus.get_size() == check(shadow_minus, only_a));
+            auto bitmaps_and = intersect(bitmaps_a, bitmaps_b, num_threads);
+            REQUIRE(static_cast<uint32_t>(bitmaps_and.get_num_elements()) ==
+                    check(bitmaps_and, both));
+            auto bitmaps_minus =
+                difference(bitmaps_a, bitmaps_b, num_threads);
+            REQUIRE(static_cast<uint32_t>(bitmaps_minus.get_num_elements()) ==
+                    check(bitmaps_minus, only_a));
+
+            merge(shadow_a, shadow_b, num_threads);
+            REQUIRE(shadow_a.get_size() == check(shadow_a, either));
+            merge(bitmaps_a, bitmaps_b, num_threads);
+            REQUIRE(static_cast<uint32_t>(bitmaps_a.get_num_elements()) ==
+                    check(bitmaps_a, either));
+            set_a.insert(erased);
+        }
+    }
+}
+
 /*TEST_CASE("builtin_ffs") {
     cout << __builtin_ffs(12) << endl;
     cout << __builtin_ffs(0) << endl;